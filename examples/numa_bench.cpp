@@ -0,0 +1,112 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// Cross-node traffic of staging memory: buffers are allocated by a thread on node 0 and
+// filled by a producer on each node in turn, once with the memory touched by the
+// allocating thread (as with zero-initialized buffers) and once left to the first touch
+// of the producer. For each case, the node holding the pages and the fill bandwidth of
+// the producer are shown, followed by the throughput of an NpyStream created on node 0
+// and written on each node.
+//
+// usage: numa_bench [directory for the test file, default: current directory]
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <npystream/npystream.hpp>
+#include <npystream/numa.hpp>
+#include <npystream/staging_buffer.hpp>
+
+#ifdef __linux__
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+namespace {
+size_t constexpr buffer_size = size_t{256} << 20;
+int constexpr passes = 8;
+uint64_t constexpr stream_records = uint64_t{32} << 20;
+
+//! node of the page holding p, as reported by move_pages(2) in query mode
+std::string page_node(char const* p) {
+#if defined(__linux__) && defined(SYS_move_pages)
+  void* page = const_cast<char*>(p);
+  int status = -1;
+  if (syscall(SYS_move_pages, 0, 1ul, &page, nullptr, &status, 0) == 0 && status >= 0) {
+    return std::to_string(status);
+  }
+#endif
+  return "?";
+}
+
+//! run f on a thread restricted to the given node and return its result
+template <typename F>
+auto on_node(unsigned node, F&& f) {
+  std::optional<decltype(f())> result;
+  std::jthread{[&] {
+    npystream::numa::pin_current_thread(node);
+    result.emplace(f());
+  }}.join();
+  return std::move(*result);
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace
+
+int main(int argc, char** argv) {
+  std::filesystem::path const dir = (argc > 1) ? argv[1] : ".";
+  unsigned const nodes = npystream::numa::node_count();
+  std::cout << std::fixed << std::setprecision(2) << nodes << " NUMA node(s)\n\n";
+
+  std::cout << "staging buffer   producer node   page node   fill GB/s\n";
+  for (bool const touched_by_creator : {true, false}) {
+    for (unsigned producer = 0; producer < nodes; ++producer) {
+      auto buffer = on_node(0, [touched_by_creator] {
+        npystream::detail::StagingBuffer b{buffer_size, npystream::HugePages::Off};
+        if (touched_by_creator) {
+          std::memset(b.data(), 0, b.size());
+        }
+        return b;
+      });
+
+      double const bandwidth = on_node(producer, [&buffer] {
+        auto const start = std::chrono::steady_clock::now();
+        for (int pass = 0; pass < passes; ++pass) {
+          std::memset(buffer.data(), pass, buffer.size());
+        }
+        return passes * static_cast<double>(buffer.size()) / seconds_since(start) / 1e9;
+      });
+
+      std::cout << (touched_by_creator ? "creator touch  " : "first touch    ") << std::setw(16)
+                << producer << std::setw(12) << page_node(buffer.data() + buffer.size() / 2)
+                << std::setw(12) << bandwidth << "\n";
+    }
+  }
+
+  std::cout << "\nNpyStream created on node 0, producer node   MB/s\n";
+  auto const path = dir / "numa_bench.npy";
+  for (unsigned producer = 0; producer < nodes; ++producer) {
+    auto stream = on_node(0, [&path] { return npystream::NpyStream<double>{path}; });
+    double const throughput = on_node(producer, [&stream] {
+      auto const start = std::chrono::steady_clock::now();
+      for (uint64_t i = 0; i < stream_records; ++i) {
+        stream << static_cast<double>(i);
+      }
+      stream.close();
+      return stream_records * sizeof(double) / seconds_since(start) / 1e6;
+    });
+    std::cout << std::setw(45) << producer << std::setw(8) << throughput << "\n";
+  }
+  std::filesystem::remove(path);
+}
@@ -17,6 +17,8 @@
 #include <utility>
 #include <vector>
 
+#include <npystream/group_by.hpp>
+#include <npystream/npyreader.hpp>
 #include <npystream/npystream.hpp>
 
 int main() {
@@ -69,5 +71,17 @@ int main() {
     stream << 18u << std::tuple{19u} << std::array<unsigned, 1>{20u};
   }
 
+  {
+    {
+      npystream::NpyStream<int, double> stream{"trades.npy", std::array{"symbol", "price"}};
+      for (int i = 0; i < 10000; ++i) {
+        stream << std::tuple{i % 7, 0.5 * i};
+      }
+    }
+
+    npystream::NpyReader<int, double> const reader{"trades.npy"};
+    npystream::group_by<0, 1>(reader, "trades-by-symbol.npy");
+  }
+
   return EXIT_SUCCESS;
 }
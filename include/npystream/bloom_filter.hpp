@@ -0,0 +1,123 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <npystream/record_observer.hpp>
+#include <npystream/tuple_util.hpp>
+
+namespace npystream {
+
+/**
+ * Blocked Bloom filter over 64 bit keys. Each key maps to one cache-line sized block
+ * of eight 64 bit words and sets one bit per word, so that a lookup touches a single
+ * cache line and the eight word tests can be evaluated with vector instructions.
+ * Integer keys of other types are converted with static_cast<uint64_t>.
+ */
+class BloomFilter {
+public:
+  //! create a filter for about expected_keys keys with the given number of bits per key
+  explicit BloomFilter(uint64_t expected_keys, double bits_per_key = 10.);
+
+  void insert(uint64_t key);
+  void insert(std::span<uint64_t const> keys);
+
+  //! false if the key has certainly not been inserted
+  bool may_contain(uint64_t key) const;
+
+  void merge(BloomFilter const& other);
+
+  //! store the filter words as plain uint64 .npy file
+  void save(std::filesystem::path const& path) const;
+
+  static BloomFilter load(std::filesystem::path const& path);
+
+private:
+  struct alignas(64) Block {
+    std::array<uint64_t, 8> words;
+  };
+
+  BloomFilter() = default;
+
+  size_t block_index(uint64_t hash) const;
+  static Block mask_of(uint64_t hash);
+
+  std::vector<Block> blocks;
+};
+
+/**
+ * Bloom filters of the same field in a collection of .npy files, loaded once to
+ * decide which files need to be opened to look up a key.
+ */
+class BloomFilterSet {
+public:
+  //! load the filters of field label ("" for plain arrays) belonging to data_files
+  BloomFilterSet(std::span<std::filesystem::path const> data_files, std::string_view label);
+
+  //! data files which may contain the key; files without filter are always included
+  std::vector<std::filesystem::path> candidates(uint64_t key) const;
+
+private:
+  std::vector<std::pair<std::filesystem::path, std::optional<BloomFilter>>> filters;
+};
+
+//! path of the Bloom filter of field label ("" for plain arrays) of the given .npy file
+std::filesystem::path bloom_filter_path(std::filesystem::path const& data_path,
+                                        std::string_view label);
+
+namespace detail {
+//! builds a Bloom filter over the integer field k of the records written into a stream
+template <tuple_like Tup, size_t k>
+class BloomFilterBuilder final : public RecordObserver {
+  using field_type = std::tuple_element_t<k, Tup>;
+  static_assert(std::integral<field_type>, "Bloom filters require integer fields");
+
+public:
+  BloomFilterBuilder(uint64_t expected_keys, double bits_per_key, std::string label)
+      : filter{expected_keys, bits_per_key}, label{std::move(label)} {}
+
+  void observe(char const* records, uint64_t count) override {
+    size_t constexpr record_size = tuple_info<Tup>::sum_sizes;
+    size_t constexpr offset = tuple_info<Tup>::offsets[k];
+    std::array<uint64_t, 256> keys;
+
+    while (count > 0) {
+      size_t const n = static_cast<size_t>(std::min<uint64_t>(count, keys.size()));
+      for (size_t i = 0; i < n; ++i) {
+        field_type v;
+        memcpy(&v, records + i * record_size + offset, sizeof(v));
+        keys[i] = static_cast<uint64_t>(v);
+      }
+      filter.insert(std::span<uint64_t const>{keys.data(), n});
+      records += n * record_size;
+      count -= n;
+    }
+  }
+
+  void finish(std::filesystem::path const& data_path) override {
+    filter.save(bloom_filter_path(data_path, label));
+  }
+
+private:
+  BloomFilter filter;
+  std::string label;
+};
+} // namespace detail
+
+} // namespace npystream
@@ -0,0 +1,50 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <ranges>
+#include <thread>
+#include <vector>
+
+#include <npystream/parallel.hpp>
+
+namespace npystream {
+
+/**
+ * Close all streams of the range (NpyStream, WideNpyStream, ...) on num_threads
+ * threads, so that the final header writes and closes of many files overlap instead of
+ * running one after the other. Returns the error of each stream, a null pointer if it
+ * was closed successfully. All streams are in the moved-from state afterwards.
+ */
+template <std::ranges::random_access_range Streams>
+  requires std::ranges::sized_range<Streams>
+std::vector<std::exception_ptr>
+close_all(Streams&& streams,
+          unsigned num_threads = std::max(1u, std::thread::hardware_concurrency())) {
+  size_t const count = std::ranges::size(streams);
+  std::vector<std::exception_ptr> errors(count);
+  std::atomic<size_t> next{};
+  num_threads =
+      static_cast<unsigned>(std::clamp<size_t>(num_threads, 1, std::max<size_t>(1, count)));
+
+  // streams are handed out one by one, as closing some may take much longer than others
+  detail::run_parallel(num_threads, [&](unsigned) {
+    for (size_t i = next++; i < count; i = next++) {
+      try {
+        std::ranges::begin(streams)[i].close();
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    }
+  });
+  return errors;
+}
+
+} // namespace npystream
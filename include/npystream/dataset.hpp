@@ -0,0 +1,292 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <npystream/mapped_file.hpp>
+#include <npystream/npy_header.hpp>
+#include <npystream/npyreader.hpp>
+#include <npystream/parallel.hpp>
+
+namespace npystream {
+
+/**
+ * Read-only view of a collection of one-dimensional .npy files ("shards") of the same
+ * data type, e.g. rotated or sharded outputs of a producer, as one logical array.
+ * Only the headers are read when opening; each shard is memory-mapped on first access.
+ * The template parameters have to match the data types of the files, as with NpyReader.
+ */
+template <npy_serializable T, npy_serializable... TArgs>
+class NpyDataset {
+  using reader_type = NpyReader<T, TArgs...>;
+
+public:
+  using tuple_type = typename reader_type::tuple_type;
+  using value_type = typename reader_type::value_type;
+
+  static size_t constexpr record_size = reader_type::record_size;
+
+  class iterator;
+
+  //! open the given files in this order, reading their headers on num_threads threads
+  explicit NpyDataset(std::vector<std::filesystem::path> const& files,
+                      unsigned num_threads = std::max(1u, std::thread::hardware_concurrency()))
+      : shards{std::make_unique<Shard[]>(files.size())}, num_shards{files.size()},
+        offsets(files.size() + 1) {
+    num_threads = static_cast<unsigned>(
+        std::clamp<size_t>(num_threads, 1, std::max<size_t>(1, num_shards)));
+    detail::run_parallel(num_threads, [&](unsigned t) {
+      for (size_t s = t; s < num_shards; s += num_threads) {
+        open_shard(shards[s], files[s]);
+      }
+    });
+
+    for (size_t s = 0; s < num_shards; ++s) {
+      offsets[s + 1] = offsets[s] + shards[s].count;
+    }
+  }
+
+  /**
+   * open all .npy files of a directory in lexicographic order of their names. Sidecar
+   * files (zone maps, sketches, ...) are skipped.
+   */
+  static NpyDataset from_directory(
+      std::filesystem::path const& directory,
+      unsigned num_threads = std::max(1u, std::thread::hardware_concurrency())) {
+    std::vector<std::filesystem::path> files;
+    for (auto const& entry : std::filesystem::directory_iterator{directory}) {
+      std::string const name = entry.path().filename().string();
+      if (entry.is_regular_file() && name.ends_with(".npy") &&
+          name.find(".npy.") == std::string::npos) {
+        files.push_back(entry.path());
+      }
+    }
+    std::sort(files.begin(), files.end());
+    return NpyDataset{files, num_threads};
+  }
+
+  /**
+   * open the files listed in a manifest, one path per line. Relative paths refer to
+   * the directory of the manifest; empty lines are ignored.
+   */
+  static NpyDataset from_manifest(
+      std::filesystem::path const& manifest,
+      unsigned num_threads = std::max(1u, std::thread::hardware_concurrency())) {
+    std::ifstream in{manifest};
+    if (!in) {
+      throw std::runtime_error{"NpyDataset: could not open manifest " + manifest.string()};
+    }
+
+    std::vector<std::filesystem::path> files;
+    for (std::string line; std::getline(in, line);) {
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      if (!line.empty()) {
+        files.push_back(manifest.parent_path() / line);
+      }
+    }
+    return NpyDataset{files, num_threads};
+  }
+
+  //! total number of records of all shards
+  uint64_t size() const {
+    return offsets.back();
+  }
+
+  size_t shard_count() const {
+    return num_shards;
+  }
+
+  std::filesystem::path const& shard_path(size_t s) const {
+    return shards[s].path;
+  }
+
+  //! global index of the first record of shard s
+  uint64_t first_record(size_t s) const {
+    return offsets[s];
+  }
+
+  //! shard containing the record with global index i
+  size_t shard_of(uint64_t i) const {
+    return static_cast<size_t>(std::upper_bound(offsets.begin(), offsets.end(), i) -
+                               offsets.begin() - 1);
+  }
+
+  //! packed records of shard s; the file is mapped on first access
+  std::span<unsigned char const> shard_data(size_t s) const {
+    Shard const& shard = shards[s];
+    std::call_once(shard.mapped, [&shard]() { shard.file.emplace(shard.path); });
+    return shard.file->bytes().subspan(shard.data_offset, shard.count * record_size);
+  }
+
+  //! pointer to the packed bytes of the record with global index i
+  unsigned char const* record(uint64_t i) const {
+    size_t const s = shard_of(i);
+    return shard_data(s).data() + (i - offsets[s]) * record_size;
+  }
+
+  //! read the k-th field of the record with global index i
+  template <size_t k>
+  std::tuple_element_t<k, tuple_type> get(uint64_t i) const {
+    return reader_type::template load<k>(record(i));
+  }
+
+  //! read the record with global index i, as scalar or std::tuple as with NpyReader
+  value_type operator[](uint64_t i) const {
+    return decode(record(i));
+  }
+
+  iterator begin() const {
+    return iterator{this, 0};
+  }
+
+  iterator end() const {
+    return iterator{this, size()};
+  }
+
+  /**
+   * Call f(i, value) for every record with global index i. Shards are distributed
+   * dynamically over num_threads threads, so f has to be thread-safe; records of a
+   * shard are visited in order by a single thread.
+   */
+  template <typename F>
+  void for_each(F&& f,
+                unsigned num_threads = std::max(1u, std::thread::hardware_concurrency())) const {
+    std::atomic<size_t> next{};
+    num_threads = static_cast<unsigned>(
+        std::clamp<size_t>(num_threads, 1, std::max<size_t>(1, num_shards)));
+    detail::run_parallel(num_threads, [&](unsigned) {
+      for (size_t s = next++; s < num_shards; s = next++) {
+        unsigned char const* rec = shard_data(s).data();
+        for (uint64_t i = offsets[s]; i < offsets[s + 1]; ++i, rec += record_size) {
+          f(i, decode(rec));
+        }
+      }
+    });
+  }
+
+  //! forward iterator over all records in global order
+  class iterator {
+  public:
+    using iterator_concept = std::forward_iterator_tag;
+    using value_type = NpyDataset::value_type;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+
+    value_type operator*() const {
+      return NpyDataset::decode(dataset->shard_data(shard).data() +
+                                (index - dataset->offsets[shard]) * record_size);
+    }
+
+    iterator& operator++() {
+      ++index;
+      skip_exhausted();
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    bool operator==(iterator const& other) const {
+      return index == other.index;
+    }
+
+  private:
+    friend class NpyDataset;
+
+    iterator(NpyDataset const* dataset, uint64_t index)
+        : dataset{dataset}, index{index}, shard{dataset->shard_of(index)} {
+      skip_exhausted();
+    }
+
+    void skip_exhausted() {
+      while (shard < dataset->num_shards && index >= dataset->offsets[shard + 1]) {
+        ++shard;
+      }
+    }
+
+    NpyDataset const* dataset{};
+    uint64_t index{};
+    size_t shard{};
+  };
+
+private:
+  struct Shard {
+    std::filesystem::path path;
+    uint64_t count{};
+    size_t data_offset{};
+    mutable std::once_flag mapped;
+    mutable std::optional<MappedFile> file;
+  };
+
+  static void open_shard(Shard& shard, std::filesystem::path const& path) {
+    auto constexpr& dtypes = tuple_info<tuple_type>::data_types;
+    auto constexpr& sizes = tuple_info<tuple_type>::element_sizes;
+    auto const fail = [&](char const* what) {
+      throw std::runtime_error{"NpyDataset: " + path.string() + ": " + what};
+    };
+
+    NpyHeader const header = read_npy_header(path);
+    if (header.shape.size() != 1) {
+      fail("only one-dimensional arrays are supported");
+    }
+    if (header.shape[0] == std::numeric_limits<uint64_t>::max()) {
+      fail("file has not been completed");
+    }
+    if (!std::equal(dtypes.cbegin(), dtypes.cend(), header.dtypes.cbegin(),
+                    header.dtypes.cend()) ||
+        !std::equal(sizes.cbegin(), sizes.cend(), header.sizes.cbegin(), header.sizes.cend())) {
+      fail("data types in file do not match");
+    }
+    uint64_t const file_size = std::filesystem::file_size(path);
+    if (file_size < header.data_offset ||
+        (file_size - header.data_offset) / record_size < header.shape[0]) {
+      fail("file is truncated");
+    }
+
+    shard.path = path;
+    shard.count = header.shape[0];
+    shard.data_offset = header.data_offset;
+  }
+
+  static value_type decode(unsigned char const* rec) {
+    if constexpr (sizeof...(TArgs) == 0) {
+      return reader_type::template load<0>(rec);
+    } else {
+      return [&]<size_t... N>(std::index_sequence<N...>) {
+        return tuple_type{reader_type::template load<N>(rec)...};
+      }(std::make_index_sequence<std::tuple_size_v<tuple_type>>{});
+    }
+  }
+
+  std::unique_ptr<Shard[]> shards;
+  size_t num_shards;
+  std::vector<uint64_t> offsets; //!< prefix sums of the record counts, offsets[0] == 0
+};
+
+} // namespace npystream
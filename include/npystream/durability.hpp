@@ -0,0 +1,64 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace npystream {
+
+/**
+ * Group commit of many NpyStreams. Sync requests from any number of threads are
+ * collected over a short window; the first requester then checkpoints the headers
+ * of all streams in the batch and makes them durable with one round of syncs while
+ * the others wait. Each stream must only be used by the thread requesting its sync.
+ */
+class DurabilityManager {
+public:
+  enum class Method {
+    DataSync,  //!< fdatasync() each descriptor of the batch
+    FileSystem //!< syncfs() once per file system of the batch (Linux only, else DataSync)
+  };
+
+  explicit DurabilityManager(std::chrono::microseconds window = std::chrono::milliseconds{1},
+                             Method method = Method::DataSync);
+
+  /**
+   * Block until all records written into the stream so far are durable, with a
+   * header reflecting their number. Errors are rethrown in the requesting thread.
+   */
+  template <typename Stream>
+  void sync(Stream& stream) {
+    request([&stream]() { stream.checkpoint(); }, stream.native_handle());
+  }
+
+private:
+  struct Request {
+    std::function<void()> checkpoint;
+    int fd;
+    std::exception_ptr error{};
+  };
+
+  void request(std::function<void()> checkpoint, int fd);
+  void lead(std::unique_lock<std::mutex>& lock);
+  void sync_batch(std::vector<Request*> const& batch) const;
+
+  std::chrono::microseconds window;
+  Method method;
+
+  std::mutex mutex;
+  std::condition_variable done;
+  std::vector<Request*> pending;
+  uint64_t open_batch{1}, completed_batch{};
+  bool leader_active{};
+};
+
+} // namespace npystream
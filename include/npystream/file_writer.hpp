@@ -0,0 +1,95 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+namespace npystream {
+
+//! a contiguous piece of memory to be written
+struct ConstBuffer {
+  char const* data;
+  size_t size;
+};
+
+/**
+ * Unbuffered writer on a raw file descriptor. Data are passed to write(2)/pwrite(2)
+ * directly from the caller's memory, without an intermediate stream buffer.
+ * Errors are reported as std::system_error.
+ */
+class FileWriter {
+public:
+  FileWriter() = default;
+
+  enum class OpenMode {
+    Truncate, //!< create the file or truncate it
+    Append    //!< create the file or continue at its end
+  };
+
+  /**
+   * open the file at the given path. Offsets passed to write_at() are relative to the
+   * beginning of the file in either mode.
+   */
+  explicit FileWriter(std::filesystem::path const& path, OpenMode mode = OpenMode::Truncate);
+
+  /**
+   * take ownership of an open file descriptor (e.g. memfd, O_TMPFILE, socket).
+   * Offsets passed to write_at() are relative to its position at this point.
+   */
+  explicit FileWriter(int fd);
+
+  FileWriter(FileWriter&& other) noexcept;
+  FileWriter& operator=(FileWriter&& other) noexcept;
+  FileWriter(FileWriter const&) = delete;
+  FileWriter& operator=(FileWriter const&) = delete;
+
+  ~FileWriter();
+
+  //! append data at the current position
+  void write(char const* data, size_t size);
+
+  /**
+   * append several pieces of memory at the current position with a single writev(2)
+   * call (if the kernel accepts them at once). The memory only needs to stay valid
+   * until the call returns.
+   */
+  void write(std::span<ConstBuffer const> buffers);
+
+  //! write data at the given offset without moving the current position
+  void write_at(char const* data, size_t size, uint64_t offset);
+
+  /**
+   * reserve disk space for size bytes from the beginning of the file without changing
+   * its size, so that subsequent writes need not allocate. This is only a hint: it has
+   * no effect where unsupported (non-Linux systems, some file systems).
+   */
+  void preallocate(uint64_t size);
+
+  //! close the descriptor, reporting errors of deferred writes
+  void close();
+
+  bool is_open() const {
+    return fd >= 0;
+  }
+
+  //! whether write_at() is possible, i.e. the descriptor is not a pipe or socket
+  bool seekable() const {
+    return base_offset >= 0;
+  }
+
+  int native_handle() const {
+    return fd;
+  }
+
+private:
+  int fd{-1};
+  int64_t base_offset{-1};
+};
+
+} // namespace npystream
@@ -0,0 +1,63 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include <npystream/huge_pages.hpp>
+
+namespace npystream {
+
+//! parameters of the adaptive flush sizing, see NpyStream::adapt_flush_size()
+struct AdaptiveFlush {
+  size_t min_bytes = 4096;    //!< lower bound of the flush threshold, also the additive step
+  size_t max_bytes = 1 << 20; //!< size of the preallocated staging buffer
+  //! flushes taking longer than this shrink the threshold, faster ones let it grow
+  std::chrono::microseconds target_latency{1000};
+  //! backing of the staging buffer, applies if max_bytes is at least 2 MiB
+  HugePages huge_pages = HugePages::Transparent;
+};
+
+/**
+ * AIMD controller of the flush threshold: each flush finishing within the target
+ * latency increases the threshold by min_bytes as long as it is also faster in bytes
+ * per second than the smoothed bandwidth of recent flushes, each slower one halves it
+ * and restarts the bandwidth estimate. Once larger flushes stop improving the
+ * bandwidth, the threshold is kept, but still probed upwards every 16 flushes. It is a
+ * whole number of records between min_bytes and max_bytes.
+ */
+class FlushController {
+public:
+  FlushController(AdaptiveFlush const& policy, size_t record_size);
+
+  //! number of records after which the staging buffer is flushed
+  uint64_t threshold() const {
+    return threshold_records;
+  }
+
+  //! maximum of threshold(), i.e. number of records the staging buffer has to hold
+  uint64_t capacity() const {
+    return max_records;
+  }
+
+  //! smoothed bandwidth of recent flushes in bytes per second
+  double bandwidth() const {
+    return smoothed_bandwidth;
+  }
+
+  //! account for a flush of the given size and duration
+  void update(size_t bytes, std::chrono::nanoseconds duration);
+
+private:
+  std::chrono::nanoseconds target_latency;
+  uint64_t min_records, max_records, step_records, threshold_records;
+  double smoothed_bandwidth{};
+  unsigned held_flushes{}; //!< flushes since the threshold last changed on a plateau
+};
+
+} // namespace npystream
@@ -0,0 +1,285 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <limits>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <npystream/npyreader.hpp>
+#include <npystream/npystream.hpp>
+#include <npystream/parallel.hpp>
+
+namespace npystream {
+
+namespace detail {
+//! accumulator type used for the sum of a field of type T
+template <typename T>
+using sum_type_t =
+    std::conditional_t<std::is_floating_point_v<T>, double,
+                       std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>>;
+
+inline uint64_t mix_hash(uint64_t x) {
+  // finalizer of splitmix64
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+//! starting value of a minimum, which any value replaces
+template <typename T>
+T constexpr min_identity =
+    std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                         : std::numeric_limits<T>::max();
+
+//! starting value of a maximum, which any value replaces
+template <typename T>
+T constexpr max_identity =
+    std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity()
+                                         : std::numeric_limits<T>::lowest();
+
+/**
+ * count, sum, minimum and maximum of a number of fields of the records sharing one key
+ *
+ * The minima and maxima start at their identity elements, so that the fields can be
+ * updated independently of each other and of the count.
+ */
+template <typename... Values>
+struct Aggregate {
+  uint64_t count{};
+  std::tuple<sum_type_t<Values>...> sums{};
+  std::tuple<Values...> mins{min_identity<Values>...}, maxs{max_identity<Values>...};
+
+  template <size_t N>
+  void update_field(std::tuple_element_t<N, std::tuple<Values...>> value) {
+    std::get<N>(sums) += value;
+    std::get<N>(mins) = std::min(std::get<N>(mins), value);
+    std::get<N>(maxs) = std::max(std::get<N>(maxs), value);
+  }
+
+  void merge(Aggregate const& other) {
+    [&]<size_t... N>(std::index_sequence<N...>) {
+      ((std::get<N>(mins) = std::min(std::get<N>(mins), std::get<N>(other.mins))), ...);
+      ((std::get<N>(maxs) = std::max(std::get<N>(maxs), std::get<N>(other.maxs))), ...);
+      ((std::get<N>(sums) += std::get<N>(other.sums)), ...);
+    }(std::index_sequence_for<Values...>{});
+    count += other.count;
+  }
+};
+
+/**
+ * Open-addressing hash table with linear probing, mapping keys to aggregates.
+ */
+template <std::integral Key, typename Agg>
+class AggregateTable {
+public:
+  explicit AggregateTable(size_t initial_capacity = 1024)
+      : keys(std::bit_ceil(std::max<size_t>(initial_capacity, 16))), aggs(keys.size()),
+        used(keys.size()) {}
+
+  Agg& operator[](Key key) {
+    return find_or_insert(key, mix_hash(static_cast<uint64_t>(key)));
+  }
+
+  Agg& find_or_insert(Key key, uint64_t hash) {
+    if (2 * (count + 1) > keys.size()) {
+      grow();
+    }
+
+    size_t const mask = keys.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      if (!used[i]) {
+        used[i] = true;
+        keys[i] = key;
+        ++count;
+        return aggs[i];
+      } else if (keys[i] == key) {
+        return aggs[i];
+      }
+    }
+  }
+
+  //! make room for n more keys, so that the next n insertions do not move any aggregate
+  void reserve(size_t n) {
+    while (2 * (count + n) > keys.size()) {
+      grow();
+    }
+  }
+
+  //! call f(key, aggregate) for each occupied slot
+  template <typename F>
+  void for_each(F&& f) const {
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (used[i]) {
+        f(keys[i], aggs[i]);
+      }
+    }
+  }
+
+  size_t size() const {
+    return count;
+  }
+
+private:
+  void grow() {
+    AggregateTable bigger(2 * keys.size());
+    for_each([&](Key key, Agg const& agg) { bigger[key] = agg; });
+    *this = std::move(bigger);
+  }
+
+  std::vector<Key> keys;
+  std::vector<Agg> aggs;
+  std::vector<unsigned char> used;
+  size_t count{};
+};
+} // namespace detail
+
+/**
+ * Group the records of a structured .npy file by the integer field KeyField and
+ * compute count, sum, minimum and maximum of each field in ValueFields per key.
+ *
+ * The input is scanned in parallel; each thread radix-partitions the rows by the upper
+ * bits of the key hash into one hash table per partition. Rows are processed in batches:
+ * the aggregates of all rows of a batch are looked up first, then the value fields are
+ * decoded and accumulated column by column. The partitions are then merged
+ * in parallel, each from the tables of its own partition only, so that high-cardinality
+ * keys do not funnel through a single table. The result is
+ * written, sorted by key, as structured .npy file with the columns
+ * (key, count, <field>_sum, <field>_min, <field>_max, ...).
+ */
+template <size_t KeyField, size_t... ValueFields, typename... Ts>
+void group_by(NpyReader<Ts...> const& reader, std::filesystem::path const& output,
+              unsigned num_threads = std::max(1u, std::thread::hardware_concurrency())) {
+  using reader_tuple = typename NpyReader<Ts...>::tuple_type;
+  using Key = std::tuple_element_t<KeyField, reader_tuple>;
+  using Agg = detail::Aggregate<std::tuple_element_t<ValueFields, reader_tuple>...>;
+  using Table = detail::AggregateTable<Key, Agg>;
+
+  static_assert(std::integral<Key> && !std::same_as<Key, bool>, "key field must be an integer");
+  static_assert((std::is_arithmetic_v<std::tuple_element_t<ValueFields, reader_tuple>> && ...),
+                "aggregated fields must be arithmetic");
+
+  num_threads = std::max(1u, num_threads);
+  uint64_t const rows = reader.size();
+  size_t constexpr batch_size = 1024;
+
+  // radix partitions of the key space by the upper bits of the key hash
+  int const partition_bits = std::bit_width(std::bit_ceil(num_threads)) - 1;
+  unsigned const num_partitions = 1u << partition_bits;
+  auto const partition_of = [partition_bits](uint64_t hash) -> unsigned {
+    return partition_bits == 0 ? 0u : static_cast<unsigned>(hash >> (64 - partition_bits));
+  };
+
+  // phase 1: thread-local aggregation over contiguous row ranges, one table per partition
+  std::vector<std::vector<Table>> local(num_threads);
+  detail::run_parallel(num_threads, [&](unsigned t) {
+    uint64_t const begin = rows * t / num_threads, end = rows * (t + 1) / num_threads;
+    std::vector<Table> tables;
+    tables.reserve(num_partitions);
+    for (unsigned p = 0; p < num_partitions; ++p) {
+      tables.emplace_back(std::max<size_t>(16, 1024 / num_partitions));
+    }
+    std::array<Key, batch_size> keys;
+    std::array<uint64_t, batch_size> hashes;
+    std::array<Agg*, batch_size> slots;
+
+    // update one value field of the whole batch at a time: the field is first decoded into
+    // a contiguous column, which the compiler can vectorize, and then added to the
+    // aggregates of the rows. The rows of a batch scatter to different aggregates, so this
+    // last step stays a scalar loop.
+    auto const update_column = [&]<size_t N, size_t Field>(uint64_t b, size_t n) {
+      std::array<std::tuple_element_t<Field, reader_tuple>, batch_size> column;
+      for (size_t i = 0; i < n; ++i) {
+        column[i] = reader.template get<Field>(b + i);
+      }
+      for (size_t i = 0; i < n; ++i) {
+        slots[i]->template update_field<N>(column[i]);
+      }
+    };
+
+    for (uint64_t b = begin; b < end; b += batch_size) {
+      size_t const n = static_cast<size_t>(std::min<uint64_t>(batch_size, end - b));
+      // decode and hash the whole batch of keys before touching the tables
+      for (size_t i = 0; i < n; ++i) {
+        keys[i] = reader.template get<KeyField>(b + i);
+        hashes[i] = detail::mix_hash(static_cast<uint64_t>(keys[i]));
+      }
+      // resolve the aggregate of each row; no table grows within the batch, which keeps the
+      // pointers valid
+      for (auto& table : tables) {
+        table.reserve(n);
+      }
+      for (size_t i = 0; i < n; ++i) {
+        slots[i] = &tables[partition_of(hashes[i])].find_or_insert(keys[i], hashes[i]);
+        ++slots[i]->count;
+      }
+      [&]<size_t... N>(std::index_sequence<N...>) {
+        (update_column.template operator()<N, ValueFields>(b, n), ...);
+      }(std::make_index_sequence<sizeof...(ValueFields)>{});
+    }
+    local[t] = std::move(tables);
+  });
+
+  // phase 2: merge the tables of each partition in parallel
+  std::vector<std::vector<std::pair<Key, Agg>>> merged(num_partitions);
+  detail::run_parallel(num_partitions, [&](unsigned p) {
+    Table table = std::move(local[0][p]);
+    for (unsigned t = 1; t < num_threads; ++t) {
+      local[t][p].for_each([&](Key key, Agg const& agg) { table[key].merge(agg); });
+    }
+    merged[p].reserve(table.size());
+    table.for_each([&](Key key, Agg const& agg) { merged[p].emplace_back(key, agg); });
+  });
+
+  std::vector<std::pair<Key, Agg>> result;
+  for (auto& m : merged) {
+    result.insert(result.end(), m.begin(), m.end());
+  }
+  std::ranges::sort(result, {}, &std::pair<Key, Agg>::first);
+
+  // phase 3: write the result
+  using record_type = decltype(std::tuple_cat(
+      std::tuple<Key, uint64_t>{},
+      std::tuple<detail::sum_type_t<std::tuple_element_t<ValueFields, reader_tuple>>,
+                 std::tuple_element_t<ValueFields, reader_tuple>,
+                 std::tuple_element_t<ValueFields, reader_tuple>>{}...));
+
+  auto const label = [&](size_t field) {
+    return reader.labels().empty() ? std::format("f{}", field)
+                                   : std::string{reader.labels()[field]};
+  };
+
+  std::vector<std::string> labels{label(KeyField), "count"};
+  for (size_t const field : std::array<size_t, sizeof...(ValueFields)>{ValueFields...}) {
+    labels.push_back(label(field) + "_sum");
+    labels.push_back(label(field) + "_min");
+    labels.push_back(label(field) + "_max");
+  }
+
+  stream_for_t<record_type> stream{output, labels};
+  for (auto const& [key, agg] : result) {
+    auto const per_field = [&]<size_t... N>(std::index_sequence<N...>) {
+      return std::tuple_cat(std::tuple{std::get<N>(agg.sums), std::get<N>(agg.mins),
+                                       std::get<N>(agg.maxs)}...);
+    }(std::make_index_sequence<sizeof...(ValueFields)>{});
+    stream << std::tuple_cat(std::tuple{key, agg.count}, per_field);
+  }
+  stream.close();
+}
+
+} // namespace npystream
@@ -0,0 +1,51 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <cstddef>
+
+namespace npystream {
+
+//! backing of large buffers and mappings with huge pages, to reduce TLB misses
+enum class HugePages {
+  Off,         //!< regular pages
+  Transparent, //!< 2 MiB-aligned memory advised for transparent huge pages (MADV_HUGEPAGE)
+  Reserved     //!< pages of the reserved huge page pool (MAP_HUGETLB), else as Transparent
+};
+
+namespace detail {
+//! size of a huge page; buffers below this size always use regular pages
+inline size_t constexpr huge_page_size = size_t{2} << 20;
+
+//! buffers of at least this size get pages of their own, see map_pages()
+inline size_t constexpr own_pages_size = size_t{64} << 10;
+
+//! anonymous memory mapping for a large buffer
+struct PageMapping {
+  char* data{};
+  size_t size{}; //!< mapped size, a multiple of the page size
+};
+
+/**
+ * Map at least size bytes of 2 MiB-aligned anonymous memory backed with huge pages as
+ * far as available. Returns an empty mapping where huge pages are not supported.
+ */
+PageMapping map_huge_pages(size_t size, HugePages policy);
+
+/**
+ * Map at least size bytes of anonymous memory with regular pages, which are placed on
+ * a NUMA node only when they are first written. Returns an empty mapping on failure and
+ * where not supported.
+ */
+PageMapping map_pages(size_t size);
+
+void unmap_pages(PageMapping const& mapping) noexcept;
+
+//! advise the kernel to back an existing mapping with huge pages, where supported
+void advise_huge_pages(void const* data, size_t size) noexcept;
+} // namespace detail
+
+} // namespace npystream
@@ -0,0 +1,46 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+#include <npystream/huge_pages.hpp>
+
+namespace npystream {
+
+/**
+ * Read-only memory mapping of a whole file. The mapping is released upon destruction.
+ */
+class MappedFile {
+public:
+  /**
+   * map the file at the given path into memory. With huge_pages other than Off, the
+   * kernel is advised to back the mapping with huge pages, which takes effect for files
+   * on tmpfs (mounted with huge=advise) or hugetlbfs and is ignored elsewhere.
+   */
+  explicit MappedFile(std::filesystem::path const& path, HugePages huge_pages = HugePages::Off);
+
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  MappedFile(MappedFile const&) = delete;
+  MappedFile& operator=(MappedFile const&) = delete;
+
+  ~MappedFile();
+
+  std::span<unsigned char const> bytes() const {
+    return {data_, size_};
+  }
+
+private:
+  void unmap() noexcept;
+
+  unsigned char const* data_{};
+  std::size_t size_{};
+};
+
+} // namespace npystream
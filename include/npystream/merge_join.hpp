@@ -0,0 +1,130 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <npystream/npyreader.hpp>
+#include <npystream/npystream.hpp>
+
+namespace npystream {
+
+//! selection of fields by index, e.g. fields<0, 2>{}
+template <size_t... N>
+using fields = std::index_sequence<N...>;
+
+enum class JoinKind {
+  Inner, //!< emit one record per pair of matching keys
+  Left,  //!< like Inner, but also emit unmatched left records with zeroed right fields
+  AsOf   //!< match each left record with the last right record whose key is not greater
+};
+
+/**
+ * Join two files that are both sorted by their key fields and write the selected
+ * fields of the joined records into a new structured .npy file.
+ *
+ * Composite keys are compared lexicographically. For JoinKind::AsOf, all key
+ * fields but the last one have to match exactly while the last one (typically a
+ * timestamp) is matched backwards, as in pandas.merge_asof(..., by=...,
+ * direction="backward"). Every left record is emitted; the right fields are zero
+ * if no match exists.
+ *
+ * Both inputs are only traversed forward, so the memory requirement does not depend
+ * on the sizes of the files. Returns the number of records written.
+ */
+template <typename... L, typename... R, size_t... LK, size_t... RK, size_t... LF, size_t... RF>
+uint64_t merge_join(NpyReader<L...> const& left, NpyReader<R...> const& right,
+                    std::filesystem::path const& output, JoinKind kind, fields<LK...>,
+                    fields<RK...>, fields<LF...>, fields<RF...>) {
+  static_assert(sizeof...(LK) == sizeof...(RK) && sizeof...(LK) > 0,
+                "number of key fields has to be equal and non-zero");
+
+  using left_tuple = typename NpyReader<L...>::tuple_type;
+  using right_tuple = typename NpyReader<R...>::tuple_type;
+  using right_record = std::tuple<std::tuple_element_t<RF, right_tuple>...>;
+  using record_type =
+      std::tuple<std::tuple_element_t<LF, left_tuple>..., std::tuple_element_t<RF, right_tuple>...>;
+
+  auto const left_key = [&](uint64_t i) { return std::tuple{left.template get<LK>(i)...}; };
+  auto const right_key = [&](uint64_t j) { return std::tuple{right.template get<RK>(j)...}; };
+
+  auto const label = [](auto const& reader, size_t field) {
+    return reader.labels().empty() ? std::format("f{}", field)
+                                   : std::string{reader.labels()[field]};
+  };
+
+  std::vector<std::string> labels{label(left, LF)...};
+  size_t const num_left_labels = labels.size();
+  for (size_t const field : std::array<size_t, sizeof...(RF)>{RF...}) {
+    std::string l = label(right, field);
+    if (std::find(labels.cbegin(), labels.cbegin() + num_left_labels, l) !=
+        labels.cbegin() + num_left_labels) {
+      l += "_right";
+    }
+    labels.push_back(std::move(l));
+  }
+
+  stream_for_t<record_type> stream{output, labels};
+  uint64_t written = 0;
+  auto const emit = [&](uint64_t i, right_record const& r) {
+    stream << std::tuple_cat(std::tuple{left.template get<LF>(i)...}, r);
+    ++written;
+  };
+  auto const right_fields = [&](uint64_t j) {
+    return right_record{right.template get<RF>(j)...};
+  };
+
+  uint64_t const num_left = left.size(), num_right = right.size();
+  uint64_t j = 0;
+
+  if (kind == JoinKind::AsOf) {
+    auto const by = [](auto const& key) {
+      return [&]<size_t... N>(std::index_sequence<N...>) {
+        return std::tuple{std::get<N>(key)...};
+      }(std::make_index_sequence<sizeof...(LK) - 1>{});
+    };
+
+    for (uint64_t i = 0; i < num_left; ++i) {
+      auto const key = left_key(i);
+      // j: first right record whose key is greater than the left one
+      while (j < num_right && !(key < right_key(j))) {
+        ++j;
+      }
+      emit(i, (j > 0 && by(right_key(j - 1)) == by(key)) ? right_fields(j - 1) : right_record{});
+    }
+  } else {
+    for (uint64_t i = 0; i < num_left; ++i) {
+      auto const key = left_key(i);
+      // j: first right record whose key is not less than the left one
+      while (j < num_right && right_key(j) < key) {
+        ++j;
+      }
+
+      bool matched = false;
+      for (uint64_t k = j; k < num_right && right_key(k) == key; ++k) {
+        emit(i, right_fields(k));
+        matched = true;
+      }
+      if (!matched && kind == JoinKind::Left) {
+        emit(i, right_record{});
+      }
+    }
+  }
+
+  stream.close();
+  return written;
+}
+
+} // namespace npystream
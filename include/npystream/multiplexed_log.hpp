@@ -0,0 +1,189 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <npystream/file_writer.hpp>
+#include <npystream/npystream.hpp>
+#include <npystream/repack.hpp>
+#include <npystream/staging_buffer.hpp>
+#include <npystream/tuple_util.hpp>
+
+namespace npystream {
+
+template <npy_serializable T, npy_serializable... TArgs>
+class LogStream;
+
+/**
+ * Shared, log-structured sink for a large number of logical streams that each write
+ * few records. Records of all streams are appended, tagged with their stream, to a
+ * single log file in large sequential writes. A background thread periodically
+ * compacts the log into one .npy file per logical stream, so that the number of write
+ * calls does not depend on the number of streams. The stream files are kept open, up
+ * to a limit, and their headers are only updated when a file is closed to make room
+ * for another one, on compact() and on close().
+ */
+class MultiplexedLog {
+public:
+  /**
+   * Create the log file at log_path. Buffered records are written to the log once
+   * buffer_bytes are reached and compacted into the stream files every interval. At
+   * most max_open_files stream files are kept open, the least recently compacted ones
+   * are closed first; with more active streams, compaction has to reopen files.
+   */
+  explicit MultiplexedLog(std::filesystem::path log_path_,
+                          std::chrono::milliseconds interval = std::chrono::seconds{1},
+                          size_t buffer_bytes = 1 << 20, size_t max_open_files = 256);
+
+  MultiplexedLog(MultiplexedLog const&) = delete;
+  MultiplexedLog& operator=(MultiplexedLog const&) = delete;
+
+  /**
+   * compact all records written so far and remove the log file, see close(). Errors are
+   * ignored here, call close() to have them reported.
+   */
+  ~MultiplexedLog();
+
+  /**
+   * Register a logical stream whose records are compacted into the .npy file at path.
+   * The labels are given as for NpyStream.
+   */
+  template <npy_serializable T, npy_serializable... TArgs>
+  LogStream<T, TArgs...> open(std::filesystem::path const& path) {
+    std::vector<std::string> labels;
+    if constexpr (sizeof...(TArgs) > 0) {
+      for (size_t i = 0; i <= sizeof...(TArgs); ++i) {
+        labels.emplace_back(std::format("f{}", i));
+      }
+    }
+    return open<T, TArgs...>(path, labels);
+  }
+
+  template <npy_serializable T, npy_serializable... TArgs, typename Container>
+  LogStream<T, TArgs...> open(std::filesystem::path const& path, Container const& labels) {
+    using tuple_type = std::tuple<T, TArgs...>;
+    auto constexpr& dtypes = tuple_info<tuple_type>::data_types;
+    auto constexpr& sizes = tuple_info<tuple_type>::element_sizes;
+    std::vector<std::string> label_strings(std::cbegin(labels), std::cend(labels));
+    uint32_t const id = add_stream(path, std::move(label_strings), dtypes, sizes);
+    return LogStream<T, TArgs...>{*this, id};
+  }
+
+  //! append one packed record of the given stream
+  void append(uint32_t stream, char const* record, size_t size);
+
+  /**
+   * write buffered records to the log and compact the log into the stream files now,
+   * and update the headers of the stream files, so that all of them are complete
+   */
+  void compact();
+
+  /**
+   * Stop the background compaction, compact all remaining records and remove the log
+   * file. Errors of background compactions are rethrown here.
+   */
+  void close();
+
+private:
+  //! a logical stream, accessed by the compactor only after registration
+  struct Stream {
+    std::filesystem::path path;
+    std::vector<std::string> labels;
+    std::vector<char> dtypes;
+    std::vector<size_t> sizes;
+    size_t record_size;
+    uint64_t records{};        //!< records compacted into the file so far
+    uint64_t header_records{}; //!< records declared by the header of the file
+    uint64_t log_end{};        //!< log bytes up to which the records are in the file
+    size_t header_end_pos{};   //!< 0 until the file has been created
+    FileWriter file{};         //!< open while in open_files
+    std::list<Stream*>::iterator lru_position{};
+  };
+
+  uint32_t add_stream(std::filesystem::path const& path, std::vector<std::string> labels,
+                      std::span<char const> dtypes, std::span<size_t const> sizes);
+  void flush_locked();
+  void compact(bool complete_files);
+  void compact_range(uint64_t begin, uint64_t end, std::span<Stream* const> streams);
+  FileWriter& open_file(Stream& stream);
+  void update_header(Stream& stream, FileWriter& file);
+  void close_file(Stream& stream);
+  void run(std::stop_token token);
+
+  std::filesystem::path log_path;
+  std::chrono::milliseconds interval;
+  size_t buffer_bytes;
+
+  std::mutex mutex; //!< guards the members below
+  FileWriter log;
+  detail::StagingBuffer buffer; //!< holds buffer_bytes, backed with huge pages if large
+  size_t buffer_used{};
+  uint64_t log_size{}; //!< bytes written to the log file
+  std::vector<std::unique_ptr<Stream>> streams;
+  std::exception_ptr error;
+
+  std::mutex compaction_mutex; //!< serializes compactions, guards the members below
+  uint64_t compacted{};        //!< log bytes compacted into all stream files
+  size_t max_open_files;
+  std::list<Stream*> open_files; //!< most recently used first
+  std::condition_variable_any wakeup;
+  std::jthread compactor;
+  bool closed{};
+};
+
+/**
+ * Handle of a logical stream of a MultiplexedLog, for writing records as with
+ * NpyStream. Handles are cheap to copy and must not outlive their log.
+ */
+template <npy_serializable T, npy_serializable... TArgs>
+class LogStream {
+  using tuple_type = std::tuple<T, TArgs...>;
+
+public:
+  //! write single scalar value into stream
+  template <std::same_as<T> U = T>
+    requires(sizeof...(TArgs) == 0)
+  LogStream& operator<<(U val) {
+    return (*this << std::tuple<T>{val});
+  }
+
+  //! write single data tuple into stream
+  template <tuple_like Tup>
+    requires(convertible<Tup, tuple_type>)
+  LogStream& operator<<(Tup const& val) {
+    std::array<char, tuple_info<tuple_type>::sum_sizes> record;
+    detail::serialize(val, record.data());
+    log->append(id, record.data(), record.size());
+    return *this;
+  }
+
+private:
+  friend class MultiplexedLog;
+
+  LogStream(MultiplexedLog& log, uint32_t id) : log{&log}, id{id} {}
+
+  MultiplexedLog* log;
+  uint32_t id;
+};
+
+} // namespace npystream
@@ -0,0 +1,51 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace npystream {
+enum class MemoryOrder { Fortran, C, ColumnMajor = Fortran, RowMajor = C };
+
+std::vector<unsigned char> create_npy_header(std::span<uint64_t const> shape, char dtype,
+                                             size_t size, MemoryOrder = MemoryOrder::C);
+
+std::vector<unsigned char> create_npy_header(std::span<uint64_t const> shape,
+                                             std::span<std::string_view const> labels,
+                                             std::span<char const> dtypes,
+                                             std::span<size_t const> sizes,
+                                             MemoryOrder memory_order);
+
+//! contents of a parsed .npy header
+struct NpyHeader {
+  std::vector<std::string> labels; //!< field names, empty for plain (non-structured) arrays
+  std::vector<char> dtypes;
+  std::vector<size_t> sizes;
+  std::vector<uint64_t> shape;
+  MemoryOrder memory_order{MemoryOrder::C};
+  size_t data_offset{}; //!< position of the first data byte in the file
+};
+
+//! parse the header of an .npy file given as its leading bytes
+NpyHeader parse_npy_header(std::span<unsigned char const> bytes);
+
+//! read and parse only the header of the .npy file at the given path
+NpyHeader read_npy_header(std::filesystem::path const& path);
+
+/**
+ * Write a complete one-dimensional structured .npy file whose packed records,
+ * described by labels, dtypes and sizes, are given as raw bytes.
+ */
+void save_npy(std::filesystem::path const& path, std::span<std::string const> labels,
+              std::span<char const> dtypes, std::span<size_t const> sizes,
+              std::span<char const> records);
+} // namespace npystream
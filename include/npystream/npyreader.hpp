@@ -0,0 +1,166 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <npystream/mapped_file.hpp>
+#include <npystream/npy_header.hpp>
+#include <npystream/npystream.hpp>
+#include <npystream/tuple_util.hpp>
+#include <npystream/zone_map.hpp>
+
+namespace npystream {
+
+/**
+ * Read-only, memory-mapped view of a one-dimensional .npy file. The template
+ * parameters have to match the data types stored in the file, as with NpyStream.
+ */
+template <npy_serializable T, npy_serializable... TArgs>
+class NpyReader {
+public:
+  using tuple_type = std::tuple<T, TArgs...>;
+  using value_type = std::conditional_t<sizeof...(TArgs) == 0, T, tuple_type>;
+
+  static size_t constexpr record_size = tuple_info<tuple_type>::sum_sizes;
+
+  //! open the .npy file at the given path, huge_pages applies to its mapping, see MappedFile
+  explicit NpyReader(std::filesystem::path const& path, HugePages huge_pages = HugePages::Off)
+      : file{path, huge_pages}, header{parse_npy_header(file.bytes())},
+        zones{ZoneMap::open_for(path, header.shape.empty() ? 0 : header.shape[0])} {
+    validate();
+  }
+
+  //! number of records in the file
+  uint64_t size() const {
+    return header.shape[0];
+  }
+
+  //! field labels of a structured file, empty otherwise
+  std::span<std::string const> labels() const {
+    return header.labels;
+  }
+
+  //! raw bytes of all records, packed as in the file
+  std::span<unsigned char const> data() const {
+    return file.bytes().subspan(header.data_offset, size() * record_size);
+  }
+
+  //! pointer to the packed bytes of the i-th record
+  unsigned char const* record(uint64_t i) const {
+    return data().data() + i * record_size;
+  }
+
+  //! read the k-th field of the i-th record
+  template <size_t k>
+  std::tuple_element_t<k, tuple_type> get(uint64_t i) const {
+    return load<k>(record(i));
+  }
+
+  //! read the i-th record, as scalar in case of plain arrays or as std::tuple otherwise
+  value_type operator[](uint64_t i) const {
+    if constexpr (sizeof...(TArgs) == 0) {
+      return get<0>(i);
+    } else {
+      return [&]<size_t... N>(std::index_sequence<N...>) {
+        return tuple_type{load<N>(record(i))...};
+      }(std::make_index_sequence<std::tuple_size_v<tuple_type>>{});
+    }
+  }
+
+  /**
+   * Call f(i) for every record i whose field k lies within [lo, hi]. Blocks of
+   * records that cannot contain such values according to the zone map of the file
+   * (see NpyStream::add_zone_map()) are skipped without being touched. Without a zone
+   * map that fits the file (see ZoneMap::open_for()), all records are scanned.
+   */
+  template <size_t k, typename F>
+  void scan(std::tuple_element_t<k, tuple_type> lo, std::tuple_element_t<k, tuple_type> hi,
+            F&& f) const {
+    auto const scan_records = [&](uint64_t begin, uint64_t end) {
+      for (uint64_t i = begin; i < end; ++i) {
+        auto const v = get<k>(i);
+        if (!(v < lo) && !(hi < v)) {
+          f(i);
+        }
+      }
+    };
+
+    std::optional<size_t> column;
+    if (zones) {
+      column = zones->column(labels().empty() ? std::string_view{"f0"} : labels()[k]);
+    }
+    if (!column) {
+      scan_records(0, size());
+      return;
+    }
+
+    uint64_t const blocks = zones->blocks();
+    for (uint64_t b = 0; b < blocks; ++b) {
+      auto const [block_min, block_max] =
+          zones->template range<std::tuple_element_t<k, tuple_type>>(b, *column);
+      if (block_max < lo || hi < block_min) {
+        continue;
+      }
+      uint64_t const end = (b + 1 < blocks) ? zones->first_record(b + 1) : size();
+      scan_records(zones->first_record(b), std::min(end, size()));
+    }
+  }
+
+  //! zone map of the file, if it has one that fits
+  std::optional<ZoneMap> const& zone_map() const {
+    return zones;
+  }
+
+  //! read the k-th field from the packed bytes of a record
+  template <size_t k>
+  static std::tuple_element_t<k, tuple_type> load(unsigned char const* rec) {
+    std::tuple_element_t<k, tuple_type> val;
+    memcpy(std::addressof(val), rec + tuple_info<tuple_type>::offsets[k], sizeof(val));
+    return val;
+  }
+
+private:
+  void validate() const {
+    auto constexpr& dtypes = tuple_info<tuple_type>::data_types;
+    auto constexpr& sizes = tuple_info<tuple_type>::element_sizes;
+
+    if (header.shape.size() != 1) {
+      throw std::runtime_error{"NpyReader: only one-dimensional arrays are supported"};
+    }
+    if (header.shape[0] == std::numeric_limits<uint64_t>::max()) {
+      throw std::runtime_error{"NpyReader: file has not been completed"};
+    }
+    if (!std::equal(dtypes.cbegin(), dtypes.cend(), header.dtypes.cbegin(),
+                    header.dtypes.cend()) ||
+        !std::equal(sizes.cbegin(), sizes.cend(), header.sizes.cbegin(), header.sizes.cend())) {
+      throw std::runtime_error{"NpyReader: data types in file do not match"};
+    }
+    if ((file.bytes().size() - header.data_offset) / record_size < size()) {
+      throw std::runtime_error{"NpyReader: file is truncated"};
+    }
+  }
+
+  MappedFile file;
+  NpyHeader header;
+  std::optional<ZoneMap> zones;
+};
+
+} // namespace npystream
@@ -6,41 +6,58 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <chrono>
 #include <complex>
 #include <concepts>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <filesystem>
 #include <format>
-#include <fstream>
 #include <initializer_list>
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <tuple>
+#include <utility>
 #include <vector>
-
+#include <version>
+#ifdef __cpp_lib_mdspan
+#  include <mdspan>
+#endif
+
+#include <npystream/bloom_filter.hpp>
+#include <npystream/file_writer.hpp>
+#include <npystream/flush_controller.hpp>
 #include <npystream/map_type.hpp>
+#include <npystream/npy_header.hpp>
+#include <npystream/probes.hpp>
+#include <npystream/record_observer.hpp>
+#include <npystream/repack.hpp>
+#include <npystream/sketch.hpp>
+#include <npystream/staging_buffer.hpp>
+#include <npystream/trace.hpp>
 #include <npystream/tuple_util.hpp>
+#include <npystream/zone_map.hpp>
 
 namespace npystream {
-enum class MemoryOrder { Fortran, C, ColumnMajor = Fortran, RowMajor = C };
-
-std::vector<unsigned char> create_npy_header(std::span<uint64_t const> shape, char dtype,
-                                             size_t size, MemoryOrder = MemoryOrder::C);
-
-std::vector<unsigned char> create_npy_header(std::span<uint64_t const> shape,
-                                             std::span<std::string_view const> labels,
-                                             std::span<char const> dtypes,
-                                             std::span<size_t const> sizes,
-                                             MemoryOrder memory_order);
+/**
+ * Write the header of a one-dimensional .npy file of yet unknown length and return its
+ * size. On seekable files, all but the magic string are zeros until wrap_up() writes the
+ * final header, so that incomplete files are recognizable. Pipes and sockets cannot be
+ * updated later and get a valid header with the shape (2**64 - 1,) instead.
+ */
+size_t begin_npy(FileWriter& file, std::span<std::string const> labels,
+                 std::span<char const> dtypes, std::span<size_t const> element_sizes);
 
-void wrap_up(std::ofstream& file, uint64_t values_written, size_t header_end_pos,
+void wrap_up(FileWriter& file, uint64_t values_written, size_t header_end_pos,
              std::span<std::string const> labels, std::span<char const> dtypes,
              std::span<size_t const> element_sizes);
 
@@ -72,26 +89,80 @@ class NpyStream {
 
 public:
   //! create a NpyStream (.npy file) at the given path.
-  NpyStream(std::filesystem::path const& path) {
-    if constexpr (std::size_t const size = std::tuple_size_v<tuple_type>; size > 1) {
-      labels.reserve(size);
-      for (std::size_t i = 0; i < size; ++i) {
-        labels.emplace_back(std::format("f{}", i));
-      }
-    }
-    init(path);
+  NpyStream(std::filesystem::path const& path)
+      : state{std::make_unique<State>()} {
+    state->path = path;
+    state->labels = default_labels();
+    init(FileWriter{path});
   }
 
   //! create a NpyStream for structured data at the given path with labelled data columns
   template <typename Container>
   NpyStream(std::filesystem::path const& path, Container const& labels_)
-      : labels{std::cbegin(labels_), std::cend(labels_)} {
-    init(path);
+      : state{std::make_unique<State>()} {
+    state->path = path;
+    state->labels.assign(std::cbegin(labels_), std::cend(labels_));
+    init(FileWriter{path});
   }
 
+  /**
+   * create a NpyStream writing into an open file descriptor (memfd, O_TMPFILE, socket, ...),
+   * which is taken over by the stream. The data are written starting at the current
+   * position of the descriptor. If it is not seekable, the header cannot be completed
+   * later; it declares the shape (2**64 - 1,) and readers have to take the number of
+   * records from the amount of data received.
+   */
+  explicit NpyStream(int fd) : state{std::make_unique<State>()} {
+    state->labels = default_labels();
+    init(FileWriter{fd});
+  }
+
+  //! create a NpyStream for structured data writing into an open file descriptor
+  template <typename Container>
+  NpyStream(int fd, Container const& labels_)
+      : state{std::make_unique<State>()} {
+    state->labels.assign(std::cbegin(labels_), std::cend(labels_));
+    init(FileWriter{fd});
+  }
+
+  /**
+   * Streams can be moved, e.g. into containers. The moved-from stream does not
+   * refer to a file anymore and must only be destroyed or assigned to.
+   */
+  NpyStream(NpyStream&&) noexcept = default;
+
+  /**
+   * complete the file of this stream and take over the other one. Errors while completing
+   * the file are ignored, use close() beforehand to have them reported.
+   */
+  NpyStream& operator=(NpyStream&& other) {
+    if (this != &other) {
+      finalize_quietly();
+      state = std::move(other.state);
+    }
+    return *this;
+  }
+
+  //! complete the file; errors are ignored here, use close() to have them reported
   ~NpyStream() {
-    flush_buffer();
-    wrap_up(file, values_written, header_end_pos, labels, dtypes, sizes);
+    finalize_quietly();
+  }
+
+  /**
+   * Write pending records and the final header, and close the file. Errors are
+   * reported as exceptions; in any case, the stream is left in the moved-from state.
+   */
+  void close() {
+    if (!state) {
+      return;
+    }
+    try {
+      finalize();
+    } catch (...) {
+      state.reset();
+      throw;
+    }
+    state.reset();
   }
 
   //! write single scalar value into stream
@@ -105,34 +176,163 @@ public:
   template <tuple_like Tup>
     requires(convertible<Tup, tuple_type>)
   NpyStream& operator<<(Tup const& val) {
-    fill(val, buffer[buffer_size].data());
-    if (++buffer_size == buffer_capacity) {
+    State& s = *state;
+    detail::serialize(val, s.staging + s.buffer_size * record_size);
+    if (++s.buffer_size == s.flush_threshold) {
       flush_buffer();
     }
-    ++values_written;
+    ++s.values_written;
     return *this;
   }
 
   void flush_buffer() {
-    file.write(buffer[0].data(), buffer_size * buffer[0].size());
-    buffer_size = 0;
+    State& s = *state;
+    size_t const bytes = s.buffer_size * record_size;
+    NPYSTREAM_PROBE2(flush_entry, s.file.native_handle(), bytes);
+    trace::Scope const scope{"flush", bytes};
+    notify(s.staging, s.buffer_size);
+    if (s.controller && s.buffer_size == s.flush_threshold) {
+      auto const start = std::chrono::steady_clock::now();
+      s.file.write(s.staging, bytes);
+      s.controller->update(bytes, std::chrono::steady_clock::now() - start);
+      s.flush_threshold = s.controller->threshold();
+      NPYSTREAM_PROBE2(flush_resize, s.file.native_handle(), s.flush_threshold * record_size);
+    } else {
+      s.file.write(s.staging, bytes);
+    }
+    s.buffer_size = 0;
+    NPYSTREAM_PROBE2(flush_return, s.file.native_handle(), bytes);
+  }
+
+  /**
+   * Write pending records and update the header to the number of records written so
+   * far, so that the file is complete up to this point. Writing may continue afterwards.
+   */
+  void checkpoint() {
+    flush_buffer();
+    wrap_up(state->file, state->values_written, state->header_end_pos, state->labels, dtypes,
+            sizes);
+  }
+
+  /**
+   * Adapt the amount of records staged before each write to the observed write latency
+   * (AIMD, see FlushController) within a staging buffer of policy.max_bytes, which is
+   * allocated here. Useful where the best write size is not known in advance, e.g. when
+   * deploying to local as well as network file systems.
+   */
+  NpyStream& adapt_flush_size(AdaptiveFlush const& policy = {}) {
+    State& s = *state;
+    flush_buffer();
+    s.controller.emplace(policy, record_size);
+    s.adaptive_buffer =
+        detail::StagingBuffer{s.controller->capacity() * record_size, policy.huge_pages};
+    s.staging = s.adaptive_buffer.data();
+    s.buffer = {};
+    s.flush_threshold = s.controller->threshold();
+    return *this;
+  }
+
+  //! number of bytes of staged records that trigger a write
+  size_t flush_threshold() const {
+    return state->flush_threshold * record_size;
+  }
+
+  //! file descriptor of the stream, e.g. for synchronization with DurabilityManager
+  int native_handle() const {
+    return state->file.native_handle();
   }
 
-  //! write contiguous block of scalar data, given as std::span, into stream
+  /**
+   * write contiguous block of scalar data, given as std::span, into stream. Pending
+   * records of the staging buffer and the data are passed to the kernel in a single
+   * vectored write; the data are not copied and need to be valid only during the call.
+   */
   template <std::same_as<T> U = T>
     requires(sizeof...(TArgs) == 0)
   NpyStream& write(std::span<U const> data) {
-    if (buffer_size) {
-      flush_buffer();
+    State& s = *state;
+    NPYSTREAM_PROBE3(write_entry, s.file.native_handle(), data.size(), data.size_bytes());
+    trace::Scope const scope{"write", data.size_bytes()};
+    char const* const bytes = reinterpret_cast<char const*>(data.data());
+    notify(s.staging, s.buffer_size);
+    notify(bytes, data.size());
+
+    std::array<ConstBuffer, 2> const pieces{
+        {{s.staging, s.buffer_size * record_size}, {bytes, sizeof(T) * data.size()}}};
+    s.file.write(pieces);
+    s.buffer_size = 0;
+    s.values_written += data.size();
+    NPYSTREAM_PROBE2(write_return, s.file.native_handle(), data.size_bytes());
+    return *this;
+  }
+
+  /**
+   * write count scalar values located stride elements apart, e.g. a column of a
+   * row-major matrix or every k-th element of a buffer. The values are gathered
+   * chunk-wise into a staging area and written together with pending records.
+   */
+  template <std::same_as<T> U = T>
+    requires(sizeof...(TArgs) == 0)
+  NpyStream& write_strided(U const* data, size_t count, std::ptrdiff_t stride) {
+    if (stride == 1) {
+      return write(std::span<U const>{data, count});
     }
-    file.write(reinterpret_cast<char const*>(data.data()), sizeof(T) * data.size());
-    values_written += data.size();
+
+    write_chunked(count, [data, stride](char* dst, size_t done, size_t n) {
+      detail::gather(data + static_cast<std::ptrdiff_t>(done) * stride, stride, n, dst);
+    });
     return *this;
   }
 
-  //! write contiguous block of scalar data, given as iterator pair, into stream
+  /**
+   * write complex values given as separate arrays of real and imaginary parts, e.g. I/Q
+   * samples, into a stream of std::complex. The parts are interleaved chunk-wise and
+   * written together with pending records, without an intermediate std::complex array.
+   */
+  template <std::same_as<T> U = T>
+    requires(sizeof...(TArgs) == 0 && detail::is_complex<U>::value)
+  NpyStream& write_split(std::span<typename U::value_type const> re,
+                         std::span<typename U::value_type const> im) {
+    if (re.size() != im.size()) {
+      throw std::runtime_error{"real and imaginary parts differ in size"};
+    }
+
+    write_chunked(re.size(), [re, im](char* dst, size_t done, size_t n) {
+      detail::interleave(re.data() + done, im.data() + done, n, dst);
+    });
+    return *this;
+  }
+
+#ifdef __cpp_lib_mdspan
+  //! write a one-dimensional, possibly strided, view of scalar data into stream
+  template <typename Extents, typename Layout>
+    requires(sizeof...(TArgs) == 0 && Extents::rank() == 1)
+  NpyStream& write(std::mdspan<T const, Extents, Layout> view) {
+    return write_strided(view.data_handle(), view.extent(0),
+                         static_cast<std::ptrdiff_t>(view.stride(0)));
+  }
+#endif
+
+  /**
+   * write contiguous block of structured data, given as std::span of tuple-like objects
+   * (std::tuple, std::pair, std::array) into stream. The objects are repacked chunk-wise
+   * into the packed record layout of the file and written together with pending records.
+   */
+  template <tuple_like U>
+    requires(std::tuple_size_v<tuple_type> > 1 && convertible<U, tuple_type>)
+  NpyStream& write(std::span<U const> data) {
+    write_chunked(data.size(), [data](char* dst, size_t done, size_t n) {
+      detail::repack(data.data() + done, n, dst);
+    });
+    return *this;
+  }
+
+  //! write contiguous block of data, given as iterator pair, into stream
   template <std::contiguous_iterator TConstIter>
-    requires(std::same_as<std::iter_value_t<TConstIter>, T> && std::tuple_size_v<tuple_type> == 1)
+    requires((std::same_as<std::iter_value_t<TConstIter>, T> &&
+              std::tuple_size_v<tuple_type> == 1) ||
+             (std::tuple_size_v<tuple_type> > 1 &&
+              convertible<std::iter_value_t<TConstIter>, tuple_type>))
   NpyStream& write(TConstIter begin, TConstIter end) {
     return write(std::span<std::add_const_t<std::iter_value_t<TConstIter>>>{begin, end});
   }
@@ -154,63 +354,196 @@ public:
     return *this;
   }
 
-private:
-  void init(std::filesystem::path const& path) {
-    uint64_t const max_elements = std::numeric_limits<uint64_t>::max();
-    std::vector<unsigned char> header;
-
-    size_t constexpr tuple_size = std::tuple_size_v<tuple_type>;
-
-    if (labels.size() == 0) {
-      if constexpr (tuple_size == 1) {
-        header = create_npy_header(std::span<uint64_t const>(&max_elements, 1), map_type(T{}),
-                                   sizeof(T));
-      } else {
-        throw std::runtime_error{
-            "labels size does not match number of elements in structured type"};
-      }
+  /**
+   * Maintain a quantile sketch (and optionally a histogram) of field k while writing.
+   * The sketches are stored next to the file when the stream is closed, as
+   * "<file>.<label>.quantiles.npy" and "<file>.<label>.histogram.npy".
+   */
+  template <size_t k>
+    requires(k < std::tuple_size_v<tuple_type>)
+  NpyStream& add_sketch(SketchOptions const& options = {}) {
+    return attach(std::make_unique<detail::FieldSketch<tuple_type, k>>(options, suffix<k>()));
+  }
+
+  /**
+   * Record minimum and maximum of the given fields (all fields if none are given)
+   * for every block of block_records records. The zone map is stored as
+   * "<file>.zonemap.npy" and allows readers to skip blocks in range queries.
+   */
+  template <size_t... Fields>
+  NpyStream& add_zone_map(uint64_t block_records = 4096) {
+    std::vector<std::string> field_labels = state->labels;
+    if (field_labels.empty()) {
+      field_labels.emplace_back("f0");
+    }
+
+    if constexpr (sizeof...(Fields) == 0) {
+      return [&]<size_t... N>(std::index_sequence<N...>) -> NpyStream& {
+        return attach(std::make_unique<detail::ZoneMapBuilder<tuple_type, N...>>(block_records,
+                                                                                 field_labels));
+      }(std::make_index_sequence<std::tuple_size_v<tuple_type>>{});
     } else {
-      if (labels.size() != tuple_size) {
-        throw std::runtime_error{
-            "labels size does not match number of elements in structured type"};
+      return attach(std::make_unique<detail::ZoneMapBuilder<tuple_type, Fields...>>(
+          block_records, field_labels));
+    }
+  }
+
+  /**
+   * Build a Bloom filter over the integer field k, sized for about expected_keys
+   * distinct keys. The filter is stored as "<file>.<label>.bloom.npy" and can be
+   * queried with BloomFilter or BloomFilterSet without opening the data.
+   */
+  template <size_t k>
+    requires(k < std::tuple_size_v<tuple_type>)
+  NpyStream& add_bloom_filter(uint64_t expected_keys, double bits_per_key = 10.) {
+    return attach(std::make_unique<detail::BloomFilterBuilder<tuple_type, k>>(
+        expected_keys, bits_per_key, state->labels.empty() ? std::string{} : state->labels[k]));
+  }
+
+  //! register an observer that sees all records written from now on
+  NpyStream& attach(std::unique_ptr<RecordObserver> observer) {
+    if (state->values_written) {
+      throw std::runtime_error{"observers have to be attached before writing data"};
+    }
+    if (state->path.empty()) {
+      throw std::runtime_error{"observers require a stream opened from a path"};
+    }
+    state->observers.push_back(std::move(observer));
+    return *this;
+  }
+
+private:
+  void finalize() {
+    checkpoint();
+    NPYSTREAM_PROBE2(close, state->file.native_handle(), state->values_written);
+    state->file.close();
+    for (auto& observer : state->observers) {
+      observer->finish(state->path);
+    }
+  }
+
+  //! finalize() for destructor and assignment, which must not throw (e.g. during unwinding)
+  void finalize_quietly() noexcept {
+    if (state) {
+      try {
+        finalize();
+      } catch (...) {
       }
+    }
+  }
 
-      std::vector<std::string_view> const label_views(labels.cbegin(), labels.cend());
-      header = create_npy_header(std::span<uint64_t const>(&max_elements, 1), label_views, dtypes,
-                                 sizes, MemoryOrder::C);
+  /**
+   * write count records chunk-wise together with pending records, each chunk of n records
+   * starting at record done being produced into the scratch area by fill(dst, done, n)
+   */
+  template <typename F>
+  void write_chunked(size_t count, F&& fill) {
+    State& s = *state;
+    size_t constexpr chunk_records = std::max<size_t>(1, bulk_chunk_size / record_size);
+    if (s.scratch.empty()) {
+      s.scratch = detail::StagingBuffer{chunk_records * record_size};
+    }
+    size_t const total_bytes = count * record_size;
+    NPYSTREAM_PROBE3(write_entry, s.file.native_handle(), count, total_bytes);
+    trace::Scope const scope{"write", total_bytes};
+
+    for (size_t done = 0; done < count;) {
+      size_t const n = std::min(chunk_records, count - done);
+      fill(s.scratch.data(), done, n);
+      notify(s.staging, s.buffer_size);
+      notify(s.scratch.data(), n);
+
+      std::array<ConstBuffer, 2> const pieces{
+          {{s.staging, s.buffer_size * record_size}, {s.scratch.data(), n * record_size}}};
+      s.file.write(pieces);
+      s.buffer_size = 0;
+      s.values_written += n;
+      done += n;
     }
+    NPYSTREAM_PROBE2(write_return, s.file.native_handle(), total_bytes);
+  }
 
-    header_end_pos = header.size();
-    std::fill(std::next(header.begin(), 8), header.end(), 0);
-    file.open(path, std::ios_base::binary);
-    file.write(reinterpret_cast<char*>(header.data()), header.size());
+  void notify(char const* records, uint64_t count) {
+    for (auto& observer : state->observers) {
+      observer->observe(records, count);
+    }
   }
 
-  template <tuple_like U, int k = 0>
-  static void fill(U const& tup, char* buffer) {
-    auto constexpr offsets = tuple_info<U>::offsets;
+  //! sidecar file name component identifying field k
+  template <size_t k>
+  std::string suffix() const {
+    std::string s;
+    if (!state->labels.empty()) {
+      s = ".";
+      s += state->labels[k];
+    }
+    return s;
+  }
 
-    if constexpr (k < tuple_info<U>::size) {
-      auto const& elem = std::get<k>(tup);
-      auto constexpr elem_size = sizeof(elem);
-      static_assert(tuple_info<U>::element_sizes[k] == elem_size); // sanity check
+  static std::vector<std::string> default_labels() {
+    std::vector<std::string> names;
+    if constexpr (std::size_t const size = std::tuple_size_v<tuple_type>; size > 1) {
+      names.reserve(size);
+      for (std::size_t i = 0; i < size; ++i) {
+        names.emplace_back(std::format("f{}", i));
+      }
+    }
+    return names;
+  }
 
-      std::array<char, elem_size> tmp{};
-      memcpy(tmp.data(), std::addressof(elem), elem_size);
-      std::copy(tmp.cbegin(), tmp.cend(), buffer + offsets[k]);
-      fill<U, k + 1>(tup, buffer);
+  void init(FileWriter&& writer) {
+    size_t const labels_size = state->labels.size();
+    if (labels_size == 0 ? std::tuple_size_v<tuple_type> != 1
+                         : labels_size != std::tuple_size_v<tuple_type>) {
+      throw std::runtime_error{"labels size does not match number of elements in structured type"};
     }
+
+    state->file = std::move(writer);
+    state->header_end_pos = begin_npy(state->file, state->labels, dtypes, sizes);
+    NPYSTREAM_PROBE3(open, state->file.native_handle(), state->header_end_pos,
+                     tuple_info<tuple_type>::sum_sizes);
   }
 
-  std::ofstream file;
-  size_t header_end_pos;
-  uint64_t values_written{}, buffer_size{};
-  std::vector<std::string> labels{};
+  static size_t constexpr record_size = tuple_info<tuple_type>::sum_sizes;
+
+  //! number of records staged by default, about 64 KiB so that writes amortize the syscall
+  static size_t constexpr buffer_capacity = std::max<size_t>(1, (1 << 16) / record_size);
+
+  //! size of the chunks in which bulk writes of structured data are repacked
+  static size_t constexpr bulk_chunk_size = 1 << 16;
 
-  static size_t constexpr buffer_capacity =
-      std::max<size_t>(1, 256 / tuple_info<tuple_type>::sum_sizes);
-  std::array<std::array<char, tuple_info<tuple_type>::sum_sizes>, buffer_capacity> buffer{};
+  //! all state lives on the heap, so that streams are cheap to move
+  struct State {
+    FileWriter file;
+    std::filesystem::path path;
+    std::vector<std::unique_ptr<RecordObserver>> observers;
+    size_t header_end_pos{};
+    uint64_t values_written{}, buffer_size{};
+    std::vector<std::string> labels{};
 
-  static_assert(sizeof(buffer) == buffer_capacity * tuple_info<tuple_type>::sum_sizes);
+    detail::StagingBuffer buffer{buffer_capacity * record_size}; //!< default staging area
+    detail::StagingBuffer scratch; //!< repacking area of bulk writes, allocated on first use
+
+    char* staging = buffer.data(); //!< records not written yet, in buffer or adaptive_buffer
+    uint64_t flush_threshold = buffer_capacity; //!< number of staged records triggering a write
+    std::optional<FlushController> controller;  //!< set by adapt_flush_size()
+    detail::StagingBuffer adaptive_buffer;
+  };
+
+  std::unique_ptr<State> state;
+};
+
+namespace detail {
+template <typename Tup>
+struct stream_for;
+
+template <typename... Ts>
+struct stream_for<std::tuple<Ts...>> {
+  using type = NpyStream<Ts...>;
 };
+} // namespace detail
+
+//! NpyStream type writing records of the given std::tuple type
+template <typename Tup>
+using stream_for_t = typename detail::stream_for<Tup>::type;
 } // namespace npystream
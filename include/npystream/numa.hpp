@@ -0,0 +1,32 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <filesystem>
+#include <optional>
+
+/**
+ * Helpers for placing writer threads on NUMA systems. Staging memory of the streams is
+ * placed by first touch, i.e. on the node of the thread that writes records into it, so
+ * a producer and its writer thread should run on the node the storage device is attached
+ * to. All functions are best effort: on systems without NUMA information (including
+ * non-Linux systems) they report no node and do nothing.
+ */
+namespace npystream::numa {
+
+//! number of NUMA nodes, 1 if unknown
+unsigned node_count();
+
+//! node of the CPU the calling thread currently runs on
+std::optional<unsigned> current_node();
+
+//! node the block device holding the given file or directory is attached to
+std::optional<unsigned> device_node(std::filesystem::path const& path);
+
+//! restrict the calling thread to the CPUs of the given node, returns false on failure
+bool pin_current_thread(unsigned node);
+
+} // namespace npystream::numa
@@ -0,0 +1,38 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace npystream::detail {
+
+//! run f(t) for t in [0, num_threads) on as many threads and rethrow the first error
+template <typename F>
+void run_parallel(unsigned num_threads, F&& f) {
+  std::vector<std::exception_ptr> errors(num_threads);
+  {
+    std::vector<std::jthread> threads;
+    threads.reserve(num_threads);
+    for (unsigned t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&, t]() {
+        try {
+          f(t);
+        } catch (...) {
+          errors[t] = std::current_exception();
+        }
+      });
+    }
+  }
+
+  for (auto const& e : errors) {
+    if (e) {
+      std::rethrow_exception(e);
+    }
+  }
+}
+} // namespace npystream::detail
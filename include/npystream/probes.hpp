@@ -0,0 +1,39 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+/**
+ * Static tracepoints (USDT) of provider "npystream", for attaching bpftrace or perf to
+ * running processes. They are compiled in if NPYSTREAM_ENABLE_USDT is defined (CMake
+ * option NPYSTREAM_USDT) and <sys/sdt.h> is available; an inactive probe is a single
+ * NOP instruction. Otherwise the macros expand to nothing and their arguments are not
+ * evaluated.
+ *
+ * Probes (all sizes in bytes):
+ *   open(fd, header_size, record_size)
+ *   flush_entry(fd, size), flush_return(fd, size)
+ *   flush_resize(fd, threshold), see NpyStream::adapt_flush_size()
+ *   write_entry(fd, records, size), write_return(fd, size)
+ *   header_entry(fd, records), header_return(fd)
+ *   close(fd, records)
+ */
+
+#if defined(NPYSTREAM_ENABLE_USDT) && defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    include <sys/sdt.h>
+#    define NPYSTREAM_HAVE_USDT
+#  endif
+#endif
+
+#ifdef NPYSTREAM_HAVE_USDT
+#  define NPYSTREAM_PROBE1(name, a) DTRACE_PROBE1(npystream, name, a)
+#  define NPYSTREAM_PROBE2(name, a, b) DTRACE_PROBE2(npystream, name, a, b)
+#  define NPYSTREAM_PROBE3(name, a, b, c) DTRACE_PROBE3(npystream, name, a, b, c)
+#else
+#  define NPYSTREAM_PROBE1(name, a) ((void)0)
+#  define NPYSTREAM_PROBE2(name, a, b) ((void)0)
+#  define NPYSTREAM_PROBE3(name, a, b, c) ((void)0)
+#endif
@@ -0,0 +1,466 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <npystream/npy_header.hpp>
+#include <npystream/npyreader.hpp>
+#include <npystream/npystream.hpp>
+#include <npystream/record_observer.hpp>
+#include <npystream/repack.hpp>
+#include <npystream/staging_buffer.hpp>
+
+namespace npystream {
+
+//! integer types float values can be quantized to
+template <typename Q>
+concept quantized_type = std::same_as<Q, int8_t> || std::same_as<Q, int16_t>;
+
+/**
+ * Linear mapping between float values x and quantized integers q, x = scale * q + offset.
+ * With block_size 0, the given scale and offset apply to the whole file; otherwise they
+ * are derived for every block of block_size values from its minimum and maximum, so that
+ * the full integer range is used. The minimum of the integer type is reserved for NaN,
+ * i.e. int16 values range from -32767 to 32767 and int8 values from -127 to 127.
+ * Infinite values do not take part in the minimum and maximum of a block and are
+ * saturated to the ends of the integer range, like any other values out of range.
+ */
+struct LinearQuantization {
+  float scale = 1;
+  float offset = 0;
+  size_t block_size = 0;
+};
+
+//! scale and offset of a block of values starting at first_record, as in the companion file
+struct QuantizationBlock {
+  uint64_t first_record;
+  float scale;
+  float offset;
+};
+static_assert(sizeof(QuantizationBlock) == 16, "QuantizationBlock must be packed");
+
+namespace detail {
+//! quantized value representing NaN
+template <quantized_type Q>
+inline Q constexpr nan_code = std::numeric_limits<Q>::min();
+
+//! path of the companion file holding the scale and offset of the quantized file data_path
+inline std::filesystem::path quantization_path(std::filesystem::path const& data_path) {
+  return sidecar_path(data_path, ".quantization.npy");
+}
+
+//! minimum and maximum of the finite ones of count values; (inf, -inf) if there are none
+inline std::pair<float, float> min_max(float const* src, size_t count) {
+  float const inf = std::numeric_limits<float>::infinity();
+  float lo = inf;
+  float hi = -inf;
+  size_t i = 0;
+#ifdef NPYSTREAM_SSE2
+  __m128 const vinf = _mm_set1_ps(inf);
+  __m128 const vneg_inf = _mm_set1_ps(-inf);
+  __m128 const sign = _mm_set1_ps(-0.f);
+  __m128 vlo = vinf;
+  __m128 vhi = vneg_inf;
+  for (; i + 4 <= count; i += 4) {
+    __m128 const v = _mm_loadu_ps(src + i);
+    // |v| < inf is false for infinities and NaN, which are replaced by neutral values
+    __m128 const finite = _mm_cmplt_ps(_mm_andnot_ps(sign, v), vinf);
+    vlo = _mm_min_ps(vlo, _mm_or_ps(_mm_and_ps(finite, v), _mm_andnot_ps(finite, vinf)));
+    vhi = _mm_max_ps(vhi, _mm_or_ps(_mm_and_ps(finite, v), _mm_andnot_ps(finite, vneg_inf)));
+  }
+  alignas(16) float los[4];
+  alignas(16) float his[4];
+  _mm_store_ps(los, vlo);
+  _mm_store_ps(his, vhi);
+  lo = std::min({los[0], los[1], los[2], los[3]});
+  hi = std::max({his[0], his[1], his[2], his[3]});
+#endif
+  for (; i < count; ++i) {
+    if (std::isfinite(src[i])) {
+      lo = (src[i] < lo) ? src[i] : lo;
+      hi = (src[i] > hi) ? src[i] : hi;
+    }
+  }
+  return {lo, hi};
+}
+
+/**
+ * Quantize count values to Q at dst: q = round((x - offset) * inv_scale), saturated to
+ * [nan_code + 1, max]; NaN is mapped to nan_code. On x86-64, 8 (int16) or 16 (int8)
+ * values are converted per step with SSE2 and packed with saturation.
+ */
+template <quantized_type Q>
+void quantize(float const* src, size_t count, float inv_scale, float offset, char* dst) {
+  float const lowest = nan_code<Q> + 1;
+  float const highest = std::numeric_limits<Q>::max();
+  size_t i = 0;
+#ifdef NPYSTREAM_SSE2
+  __m128 const vscale = _mm_set1_ps(inv_scale);
+  __m128 const voffset = _mm_set1_ps(offset);
+  __m128 const vlowest = _mm_set1_ps(lowest);
+  __m128 const vhighest = _mm_set1_ps(highest);
+  __m128i const vnan = _mm_set1_epi32(nan_code<Q>);
+  auto const convert = [&](float const* p) {
+    __m128 const x = _mm_loadu_ps(p);
+    __m128 const v = _mm_mul_ps(_mm_sub_ps(x, voffset), vscale);
+    __m128i const q = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(v, vlowest), vhighest));
+    __m128i const is_nan = _mm_castps_si128(_mm_cmpunord_ps(x, x));
+    return _mm_or_si128(_mm_and_si128(is_nan, vnan), _mm_andnot_si128(is_nan, q));
+  };
+  if constexpr (sizeof(Q) == 2) {
+    for (; i + 8 <= count; i += 8) {
+      __m128i const q = _mm_packs_epi32(convert(src + i), convert(src + i + 4));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * sizeof(Q)), q);
+    }
+  } else {
+    for (; i + 16 <= count; i += 16) {
+      __m128i const a = _mm_packs_epi32(convert(src + i), convert(src + i + 4));
+      __m128i const b = _mm_packs_epi32(convert(src + i + 8), convert(src + i + 12));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi16(a, b));
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    float v = (src[i] - offset) * inv_scale;
+    v = (v > lowest) ? v : lowest;
+    v = (v < highest) ? v : highest;
+    Q const q = std::isnan(src[i]) ? nan_code<Q> : static_cast<Q>(std::nearbyint(v));
+    memcpy(dst + i * sizeof(Q), &q, sizeof(Q));
+  }
+}
+
+/**
+ * dequantize count values of type Q at src to x = scale * q + offset, and nan_code to NaN,
+ * with SSE2 on x86-64
+ */
+template <quantized_type Q>
+void dequantize(unsigned char const* src, size_t count, float scale, float offset, float* dst) {
+  float const nan = std::numeric_limits<float>::quiet_NaN();
+  size_t i = 0;
+#ifdef NPYSTREAM_SSE2
+  __m128 const vscale = _mm_set1_ps(scale);
+  __m128 const voffset = _mm_set1_ps(offset);
+  __m128i const vnan_code = _mm_set1_epi32(nan_code<Q>);
+  __m128 const vnan = _mm_set1_ps(nan);
+  auto const convert = [&](__m128i q32, float* p) {
+    __m128 const v = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(q32), vscale), voffset);
+    __m128 const is_nan = _mm_castsi128_ps(_mm_cmpeq_epi32(q32, vnan_code));
+    _mm_storeu_ps(p, _mm_or_ps(_mm_and_ps(is_nan, vnan), _mm_andnot_ps(is_nan, v)));
+  };
+  // sign extension: duplicate each value into the upper half and shift it back down
+  auto const widen_to_32 = [&](__m128i q16, float* p) {
+    convert(_mm_srai_epi32(_mm_unpacklo_epi16(q16, q16), 16), p);
+    convert(_mm_srai_epi32(_mm_unpackhi_epi16(q16, q16), 16), p + 4);
+  };
+  if constexpr (sizeof(Q) == 2) {
+    for (; i + 8 <= count; i += 8) {
+      widen_to_32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * sizeof(Q))),
+                  dst + i);
+    }
+  } else {
+    for (; i + 16 <= count; i += 16) {
+      __m128i const q8 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+      widen_to_32(_mm_srai_epi16(_mm_unpacklo_epi8(q8, q8), 8), dst + i);
+      widen_to_32(_mm_srai_epi16(_mm_unpackhi_epi8(q8, q8), 8), dst + i + 8);
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    Q q;
+    memcpy(&q, src + i * sizeof(Q), sizeof(Q));
+    dst[i] = (q == nan_code<Q>) ? nan : scale * static_cast<float>(q) + offset;
+  }
+}
+} // namespace detail
+
+/**
+ * Stream adaptor that writes float values as quantized integers Q into a .npy file,
+ * according to a LinearQuantization. Scale and offset are written on close() to the
+ * companion file "<file>.quantization.npy" with the fields (first_record, scale, offset),
+ * one record per block; DequantizingNpyReader restores the float values.
+ */
+template <quantized_type Q>
+class QuantizingNpyStream {
+public:
+  QuantizingNpyStream(std::filesystem::path const& path, LinearQuantization const& quantization) {
+    bool const fixed = (quantization.block_size == 0);
+    if (fixed && (!std::isfinite(quantization.scale) || quantization.scale == 0 ||
+                  !std::isfinite(quantization.offset))) {
+      throw std::runtime_error{
+          "LinearQuantization: scale and offset have to be finite, scale nonzero"};
+    }
+
+    state = std::make_unique<State>(path, quantization);
+    if (fixed) {
+      state->blocks.push_back({0, quantization.scale, quantization.offset});
+    } else {
+      state->pending.reserve(quantization.block_size);
+    }
+  }
+
+  QuantizingNpyStream(QuantizingNpyStream&&) noexcept = default;
+
+  //! complete the files of this stream and take over the other one, see NpyStream
+  QuantizingNpyStream& operator=(QuantizingNpyStream&& other) {
+    if (this != &other) {
+      finalize_quietly();
+      state = std::move(other.state);
+    }
+    return *this;
+  }
+
+  //! complete the files; errors are ignored here, use close() to have them reported
+  ~QuantizingNpyStream() {
+    finalize_quietly();
+  }
+
+  //! write pending values, the final header and the companion file, see NpyStream::close()
+  void close() {
+    if (!state) {
+      return;
+    }
+    try {
+      finalize();
+    } catch (...) {
+      state.reset();
+      throw;
+    }
+    state.reset();
+  }
+
+  //! quantize and write a single value
+  QuantizingNpyStream& operator<<(float value) {
+    State& s = *state;
+    if (s.quantization.block_size == 0) {
+      Q q;
+      detail::quantize<Q>(&value, 1, 1 / s.quantization.scale, s.quantization.offset,
+                          reinterpret_cast<char*>(&q));
+      s.stream << q;
+      ++s.values_written;
+      return *this;
+    }
+
+    s.pending.push_back(value);
+    if (s.pending.size() == s.quantization.block_size) {
+      write_block(s.pending);
+      s.pending.clear();
+    }
+    return *this;
+  }
+
+  //! quantize and write a contiguous block of values
+  QuantizingNpyStream& write(std::span<float const> values) {
+    State& s = *state;
+    size_t const block_size = s.quantization.block_size;
+    if (block_size == 0) {
+      write_quantized(values, s.blocks.front());
+      return *this;
+    }
+
+    // whole blocks are quantized in place, only partial blocks are collected
+    while (!values.empty()) {
+      if (s.pending.empty() && values.size() >= block_size) {
+        write_block(values.first(block_size));
+        values = values.subspan(block_size);
+        continue;
+      }
+      size_t const n = std::min(block_size - s.pending.size(), values.size());
+      s.pending.insert(s.pending.end(), values.begin(), values.begin() + n);
+      values = values.subspan(n);
+      if (s.pending.size() == block_size) {
+        write_block(s.pending);
+        s.pending.clear();
+      }
+    }
+    return *this;
+  }
+
+  //! scale and offset of the blocks written so far
+  std::span<QuantizationBlock const> blocks() const {
+    return state->blocks;
+  }
+
+private:
+  void finalize() {
+    State& s = *state;
+    if (!s.pending.empty()) {
+      write_block(s.pending);
+      s.pending.clear();
+    }
+    s.stream.close();
+
+    static std::string const labels[] = {"first_record", "scale", "offset"};
+    static char const dtypes[] = {'u', 'f', 'f'};
+    static size_t const sizes[] = {sizeof(uint64_t), sizeof(float), sizeof(float)};
+    save_npy(detail::quantization_path(s.path), labels, dtypes, sizes,
+             {reinterpret_cast<char const*>(s.blocks.data()),
+              s.blocks.size() * sizeof(QuantizationBlock)});
+  }
+
+  void finalize_quietly() noexcept {
+    if (state) {
+      try {
+        finalize();
+      } catch (...) {
+      }
+    }
+  }
+
+  /**
+   * derive scale and offset of a block from the minimum and maximum of its finite values
+   * and write it. The block is mapped to [nan_code + 1, max], leaving nan_code for NaN.
+   */
+  void write_block(std::span<float const> values) {
+    State& s = *state;
+    auto const [lo, hi] = detail::min_max(values.data(), values.size());
+    float const lowest = detail::nan_code<Q> + 1;
+    float const range = float(std::numeric_limits<Q>::max()) - lowest;
+    QuantizationBlock block{s.values_written, 1, std::isfinite(lo) ? lo : 0};
+    if (hi > lo) {
+      // hi - lo may overflow for values of large magnitude
+      block.scale = hi / range - lo / range;
+      block.offset = lo - block.scale * lowest;
+    }
+    s.blocks.push_back(block);
+    write_quantized(values, block);
+  }
+
+  void write_quantized(std::span<float const> values, QuantizationBlock const& block) {
+    State& s = *state;
+    size_t constexpr chunk_values = (1 << 16) / sizeof(Q);
+    if (s.scratch.empty()) {
+      s.scratch = detail::StagingBuffer{chunk_values * sizeof(Q)};
+    }
+    float const inv_scale = 1 / block.scale;
+    for (size_t done = 0; done < values.size();) {
+      size_t const n = std::min(chunk_values, values.size() - done);
+      detail::quantize<Q>(values.data() + done, n, inv_scale, block.offset, s.scratch.data());
+      s.stream.write(std::span<Q const>{reinterpret_cast<Q const*>(s.scratch.data()), n});
+      done += n;
+    }
+    s.values_written += values.size();
+  }
+
+  struct State {
+    State(std::filesystem::path const& path, LinearQuantization const& quantization)
+        : stream{path}, path{path}, quantization{quantization} {}
+
+    NpyStream<Q> stream;
+    std::filesystem::path path;
+    LinearQuantization quantization;
+    uint64_t values_written{};
+    std::vector<QuantizationBlock> blocks;
+    std::vector<float> pending; //!< values of the current, incomplete block
+    detail::StagingBuffer scratch;
+  };
+
+  std::unique_ptr<State> state;
+};
+
+/**
+ * Read access to a file written by QuantizingNpyStream, restoring the float values with
+ * the scale and offset of its companion file.
+ */
+template <quantized_type Q>
+class DequantizingNpyReader {
+public:
+  explicit DequantizingNpyReader(std::filesystem::path const& path,
+                                 HugePages huge_pages = HugePages::Off)
+      : data{path, huge_pages} {
+    auto const params_path = detail::quantization_path(path);
+    if (!std::filesystem::exists(params_path)) {
+      throw std::runtime_error{"DequantizingNpyReader: missing " + params_path.string()};
+    }
+    NpyReader<uint64_t, float, float> const params{params_path};
+    blocks.reserve(params.size());
+    for (uint64_t b = 0; b < params.size(); ++b) {
+      blocks.push_back({params.template get<0>(b), params.template get<1>(b),
+                        params.template get<2>(b)});
+    }
+    // blocks have to start at record 0 and with strictly increasing records within the file
+    bool covered = data.size() == 0 || (!blocks.empty() && blocks.front().first_record == 0);
+    for (size_t b = 1; covered && b < blocks.size(); ++b) {
+      covered = blocks[b].first_record > blocks[b - 1].first_record &&
+                blocks[b].first_record < data.size();
+    }
+    if (!covered) {
+      throw std::runtime_error{"DequantizingNpyReader: scale and offset do not cover file"};
+    }
+  }
+
+  //! number of values in the file
+  uint64_t size() const {
+    return data.size();
+  }
+
+  //! the i-th value
+  float operator[](uint64_t i) const {
+    QuantizationBlock const& block = *block_of(i);
+    float value;
+    detail::dequantize<Q>(data.record(i), 1, block.scale, block.offset, &value);
+    return value;
+  }
+
+  //! dequantize out.size() values starting at index first into out
+  void read(uint64_t first, std::span<float> out) const {
+    if (first > size() || out.size() > size() - first) {
+      throw std::out_of_range{"DequantizingNpyReader: read beyond end of file"};
+    }
+    if (out.empty()) {
+      return;
+    }
+    auto block = block_of(first);
+    for (size_t done = 0; done < out.size(); ++block) {
+      uint64_t const block_end = (block + 1 == blocks.end()) ? size() : (block + 1)->first_record;
+      size_t const n = static_cast<size_t>(
+          std::min<uint64_t>(out.size() - done, block_end - (first + done)));
+      detail::dequantize<Q>(data.record(first + done), n, block->scale, block->offset,
+                            out.data() + done);
+      done += n;
+    }
+  }
+
+  //! all values of the file
+  std::vector<float> values() const {
+    std::vector<float> out(size());
+    read(0, out);
+    return out;
+  }
+
+  //! scale and offset of all blocks
+  std::span<QuantizationBlock const> quantization() const {
+    return blocks;
+  }
+
+private:
+  using block_iterator = std::vector<QuantizationBlock>::const_iterator;
+
+  block_iterator block_of(uint64_t i) const {
+    return std::prev(std::upper_bound(
+        blocks.begin(), blocks.end(), i,
+        [](uint64_t index, QuantizationBlock const& b) { return index < b.first_record; }));
+  }
+
+  NpyReader<Q> data;
+  std::vector<QuantizationBlock> blocks;
+};
+
+} // namespace npystream
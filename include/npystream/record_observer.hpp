@@ -0,0 +1,37 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace npystream {
+
+/**
+ * Interface for optional per-stream extensions (sketches, indices, ...) that see
+ * every record written into an NpyStream and persist their state next to the file.
+ */
+class RecordObserver {
+public:
+  virtual ~RecordObserver() = default;
+
+  //! called with records, in their packed on-disk layout, before they are written
+  virtual void observe(char const* records, uint64_t count) = 0;
+
+  //! called after the .npy file at data_path has been completed
+  virtual void finish(std::filesystem::path const& data_path) = 0;
+};
+
+//! path of a file stored alongside the .npy file at data_path, e.g. "data.npy.price.zonemap.npy"
+inline std::filesystem::path sidecar_path(std::filesystem::path const& data_path,
+                                          std::string_view suffix) {
+  std::filesystem::path p = data_path;
+  p += suffix;
+  return p;
+}
+
+} // namespace npystream
@@ -0,0 +1,225 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <npystream/tuple_util.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define NPYSTREAM_SSE2 1
+#endif
+
+namespace npystream::detail {
+
+/**
+ * Offsets of the elements of tuple-like types whose layout is known at compile
+ * time. std::tuple is not among them: it is not standard-layout, and libstdc++
+ * even stores its elements in reverse order.
+ */
+template <typename U>
+struct static_layout {
+  static bool constexpr known = false;
+};
+
+template <typename E, size_t N>
+struct static_layout<std::array<E, N>> {
+  static bool constexpr known = true;
+  static std::array<size_t, N> constexpr offsets = []() {
+    std::array<size_t, N> values{};
+    for (size_t k = 0; k < N; ++k) {
+      values[k] = k * sizeof(E);
+    }
+    return values;
+  }();
+};
+
+template <typename A, typename B>
+  requires(std::is_standard_layout_v<std::pair<A, B>>)
+struct static_layout<std::pair<A, B>> {
+  using pair_type = std::pair<A, B>;
+  static bool constexpr known = true;
+  static std::array<size_t, 2> constexpr offsets = {offsetof(pair_type, first),
+                                                    offsetof(pair_type, second)};
+};
+
+//! a single memcpy of the plan
+struct CopyRun {
+  size_t src, dst, size;
+};
+
+/**
+ * Copy plan from the layout of U to the packed record layout, in which fields that
+ * are adjacent both in the source object and in the record are merged into one run.
+ */
+template <tuple_like U>
+  requires(static_layout<U>::known)
+struct copy_plan {
+private:
+  static auto constexpr plan = []() {
+    auto constexpr& src = static_layout<U>::offsets;
+    auto constexpr& dst = tuple_info<U>::offsets;
+    auto constexpr& sizes = tuple_info<U>::element_sizes;
+
+    std::array<CopyRun, tuple_info<U>::size> runs{};
+    size_t count = 0;
+    for (size_t k = 0; k < tuple_info<U>::size; ++k) {
+      if (count > 0 && runs[count - 1].src + runs[count - 1].size == src[k] &&
+          runs[count - 1].dst + runs[count - 1].size == dst[k]) {
+        runs[count - 1].size += sizes[k];
+      } else {
+        runs[count++] = {src[k], dst[k], sizes[k]};
+      }
+    }
+    return std::pair{runs, count};
+  }();
+
+public:
+  static size_t constexpr size = plan.second;
+  static std::array<CopyRun, size> constexpr runs = []() {
+    std::array<CopyRun, size> r{};
+    std::copy_n(plan.first.cbegin(), size, r.begin());
+    return r;
+  }();
+};
+
+/**
+ * Offsets of the elements within an object of the tuple-like type U whose layout is
+ * not known at compile time. They are determined once from a value-initialized object.
+ */
+template <tuple_like U>
+struct source_layout {
+  static_assert(std::is_default_constructible_v<U> && !std::is_polymorphic_v<U>);
+
+  static inline std::array<size_t, tuple_info<U>::size> const offsets = []() {
+    U const obj{};
+    auto const base = reinterpret_cast<char const*>(std::addressof(obj));
+    return [&]<size_t... N>(std::index_sequence<N...>) {
+      return std::array<size_t, sizeof...(N)>{static_cast<size_t>(
+          reinterpret_cast<char const*>(std::addressof(std::get<N>(obj))) - base)...};
+    }(std::make_index_sequence<tuple_info<U>::size>{});
+  }();
+};
+
+//! copy the object at src according to the compile-time copy plan of U
+template <tuple_like U>
+  requires(static_layout<U>::known)
+inline void apply_plan(char const* src, char* dst) {
+  [&]<size_t... R>(std::index_sequence<R...>) {
+    (memcpy(dst + copy_plan<U>::runs[R].dst, src + copy_plan<U>::runs[R].src,
+            copy_plan<U>::runs[R].size),
+     ...);
+  }(std::make_index_sequence<copy_plan<U>::size>{});
+}
+
+//! serialize a single tuple-like value into a packed record at dst
+template <tuple_like U>
+void serialize(U const& val, char* dst) {
+  if constexpr (static_layout<U>::known) {
+    apply_plan<U>(reinterpret_cast<char const*>(std::addressof(val)), dst);
+  } else {
+    // element-wise via std::get, which also covers tuples of references
+    [&]<size_t... N>(std::index_sequence<N...>) {
+      (memcpy(dst + tuple_info<U>::offsets[N], std::addressof(std::get<N>(val)),
+              tuple_info<U>::element_sizes[N]),
+       ...);
+    }(std::make_index_sequence<tuple_info<U>::size>{});
+  }
+}
+
+/**
+ * Copy count objects of type U into packed records at dst. For types with a
+ * compile-time layout the coalesced copy plan is used; otherwise the plan (source
+ * offset, destination offset, size of each element) is fixed before the loop. The
+ * copy sizes are compile-time constants in both cases, so each copy becomes a
+ * sequence of plain moves.
+ */
+template <tuple_like U>
+void repack(U const* src, size_t count, char* dst) {
+  size_t constexpr record_size = tuple_info<U>::sum_sizes;
+  char const* in = reinterpret_cast<char const*>(src);
+
+  if constexpr (static_layout<U>::known) {
+    for (size_t i = 0; i < count; ++i, in += sizeof(U), dst += record_size) {
+      apply_plan<U>(in, dst);
+    }
+  } else {
+    auto constexpr& dst_offsets = tuple_info<U>::offsets;
+    auto constexpr& sizes = tuple_info<U>::element_sizes;
+    auto const& src_offsets = source_layout<U>::offsets;
+
+    [&]<size_t... N>(std::index_sequence<N...>) {
+      size_t const from[] = {src_offsets[N]...};
+      for (size_t i = 0; i < count; ++i, in += sizeof(U), dst += record_size) {
+        (memcpy(dst + dst_offsets[N], in + from[N], sizes[N]), ...);
+      }
+    }(std::make_index_sequence<tuple_info<U>::size>{});
+  }
+}
+
+/**
+ * Gather count values of type T located stride elements apart into consecutive
+ * memory at dst. The loop is unrolled so that several independent loads are in
+ * flight at once.
+ */
+template <typename T>
+void gather(T const* src, std::ptrdiff_t stride, size_t count, char* dst) {
+  auto const at = [&](size_t i) { return src + static_cast<std::ptrdiff_t>(i) * stride; };
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    memcpy(dst + i * sizeof(T), at(i), sizeof(T));
+    memcpy(dst + (i + 1) * sizeof(T), at(i + 1), sizeof(T));
+    memcpy(dst + (i + 2) * sizeof(T), at(i + 2), sizeof(T));
+    memcpy(dst + (i + 3) * sizeof(T), at(i + 3), sizeof(T));
+  }
+  for (; i < count; ++i) {
+    memcpy(dst + i * sizeof(T), at(i), sizeof(T));
+  }
+}
+
+/**
+ * Interleave count real parts and imaginary parts from separate arrays into the layout
+ * of std::complex<F> at dst. On x86-64, four floats or two doubles of each array are
+ * combined per step with SSE2 unpack instructions.
+ */
+template <std::floating_point F>
+void interleave(F const* re, F const* im, size_t count, char* dst) {
+  size_t i = 0;
+#ifdef NPYSTREAM_SSE2
+  if constexpr (std::is_same_v<F, float>) {
+    for (; i + 4 <= count; i += 4) {
+      __m128 const r = _mm_loadu_ps(re + i);
+      __m128 const m = _mm_loadu_ps(im + i);
+      float* const out = reinterpret_cast<float*>(dst) + 2 * i;
+      _mm_storeu_ps(out, _mm_unpacklo_ps(r, m));
+      _mm_storeu_ps(out + 4, _mm_unpackhi_ps(r, m));
+    }
+  } else if constexpr (std::is_same_v<F, double>) {
+    for (; i + 2 <= count; i += 2) {
+      __m128d const r = _mm_loadu_pd(re + i);
+      __m128d const m = _mm_loadu_pd(im + i);
+      double* const out = reinterpret_cast<double*>(dst) + 2 * i;
+      _mm_storeu_pd(out, _mm_unpacklo_pd(r, m));
+      _mm_storeu_pd(out + 2, _mm_unpackhi_pd(r, m));
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    memcpy(dst + 2 * i * sizeof(F), re + i, sizeof(F));
+    memcpy(dst + (2 * i + 1) * sizeof(F), im + i, sizeof(F));
+  }
+}
+
+} // namespace npystream::detail
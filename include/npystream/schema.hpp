@@ -0,0 +1,199 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <npystream/npyreader.hpp>
+#include <npystream/npystream.hpp>
+#include <npystream/sketch.hpp>
+
+namespace npystream {
+
+//! string literal usable as template argument, e.g. field<"px", double>
+template <size_t N>
+struct fixed_string {
+  char value[N]{};
+
+  constexpr fixed_string(char const (&str)[N]) {
+    std::copy_n(str, N, value);
+  }
+
+  constexpr std::string_view view() const {
+    return {value, N - 1};
+  }
+};
+
+//! named field of a compile-time schema
+template <fixed_string Name, npy_serializable T>
+struct field {
+  using type = T;
+  static std::string_view constexpr name = Name.view();
+};
+
+namespace detail {
+template <typename T>
+struct is_field : std::false_type {};
+
+template <fixed_string Name, typename T>
+struct is_field<field<Name, T>> : std::true_type {};
+
+template <typename... Fields>
+bool constexpr unique_names() {
+  std::array<std::string_view, sizeof...(Fields)> names{Fields::name...};
+  std::ranges::sort(names);
+  return std::ranges::adjacent_find(names) == names.end();
+}
+
+template <fixed_string Name, typename... Fields>
+size_t constexpr field_index() {
+  std::array<std::string_view, sizeof...(Fields)> constexpr names{Fields::name...};
+  return std::ranges::find(names, Name.view()) - names.begin();
+}
+} // namespace detail
+
+template <typename T>
+concept field_type = detail::is_field<T>::value;
+
+/**
+ * Compile-time description of a record type with named fields. Provides the
+ * labels and the position of each field by name.
+ */
+template <field_type... Fields>
+  requires(sizeof...(Fields) > 0 && detail::unique_names<Fields...>())
+struct Schema {
+  using tuple_type = std::tuple<typename Fields::type...>;
+
+  static std::array<std::string_view, sizeof...(Fields)> constexpr labels{Fields::name...};
+
+  template <fixed_string Name>
+  static size_t constexpr index_of = detail::field_index<Name, Fields...>();
+
+  template <fixed_string Name>
+    requires(index_of<Name> < sizeof...(Fields))
+  using type_of = std::tuple_element_t<index_of<Name>, tuple_type>;
+};
+
+/**
+ * A record of a schema whose fields are set by name, e.g.
+ * Record<...>{}.set<"ts">(17).set<"px">(1.5). Fields not set are zero.
+ */
+template <field_type... Fields>
+class Record {
+  using schema = Schema<Fields...>;
+
+public:
+  using tuple_type = typename schema::tuple_type;
+
+  template <fixed_string Name>
+  Record& set(typename schema::template type_of<Name> value) {
+    std::get<schema::template index_of<Name>>(values) = value;
+    return *this;
+  }
+
+  template <fixed_string Name>
+  typename schema::template type_of<Name> get() const {
+    return std::get<schema::template index_of<Name>>(values);
+  }
+
+  tuple_type values{};
+};
+
+/**
+ * NpyStream whose labels and field types are given by a compile-time schema,
+ * e.g. NamedNpyStream<field<"ts", int64_t>, field<"px", double>>. Records can be
+ * written as tuples, as with NpyStream, or as Record built by field name.
+ *
+ * The labels are compile-time constants, but the header is built at runtime by
+ * NpyStream: its shape entry is only known when the file is closed.
+ */
+template <field_type... Fields>
+class NamedNpyStream : public NpyStream<typename Fields::type...> {
+  using base = NpyStream<typename Fields::type...>;
+
+public:
+  using schema = Schema<Fields...>;
+  using record_type = Record<Fields...>;
+
+  explicit NamedNpyStream(std::filesystem::path const& path) : base{path, schema::labels} {}
+
+  explicit NamedNpyStream(int fd) : base{fd, schema::labels} {}
+
+  using base::operator<<;
+
+  NamedNpyStream& operator<<(record_type const& rec) {
+    base::operator<<(rec.values);
+    return *this;
+  }
+
+  //! see NpyStream::add_sketch()
+  template <fixed_string Name>
+  NamedNpyStream& add_sketch(SketchOptions const& options = {}) {
+    base::template add_sketch<schema::template index_of<Name>>(options);
+    return *this;
+  }
+
+  //! see NpyStream::add_zone_map()
+  template <fixed_string... Names>
+  NamedNpyStream& add_zone_map(uint64_t block_records = 4096) {
+    base::template add_zone_map<schema::template index_of<Names>...>(block_records);
+    return *this;
+  }
+
+  //! see NpyStream::add_bloom_filter()
+  template <fixed_string Name>
+  NamedNpyStream& add_bloom_filter(uint64_t expected_keys, double bits_per_key = 10.) {
+    base::template add_bloom_filter<schema::template index_of<Name>>(expected_keys,
+                                                                      bits_per_key);
+    return *this;
+  }
+};
+
+/**
+ * NpyReader for files written with a schema; fields are accessed by name. The
+ * labels in the file have to match those of the schema.
+ */
+template <field_type... Fields>
+class NamedNpyReader : public NpyReader<typename Fields::type...> {
+  using base = NpyReader<typename Fields::type...>;
+
+public:
+  using schema = Schema<Fields...>;
+
+  explicit NamedNpyReader(std::filesystem::path const& path) : base{path} {
+    auto const file_labels = base::labels();
+    if (!std::equal(schema::labels.cbegin(), schema::labels.cend(), file_labels.begin(),
+                    file_labels.end())) {
+      throw std::runtime_error{"NamedNpyReader: field labels in file do not match"};
+    }
+  }
+
+  using base::get;
+
+  //! read the field called Name of the i-th record
+  template <fixed_string Name>
+  typename schema::template type_of<Name> get(uint64_t i) const {
+    return base::template get<schema::template index_of<Name>>(i);
+  }
+
+  //! see NpyReader::scan()
+  template <fixed_string Name, typename F>
+  void scan(typename schema::template type_of<Name> lo, typename schema::template type_of<Name> hi,
+            F&& f) const {
+    base::template scan<schema::template index_of<Name>>(lo, hi, std::forward<F>(f));
+  }
+};
+
+} // namespace npystream
@@ -0,0 +1,164 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <npystream/record_observer.hpp>
+#include <npystream/tuple_util.hpp>
+
+namespace npystream {
+
+/**
+ * KLL quantile sketch (Karnin, Lang, Liberty 2016). The rank error is about
+ * 1.7 / k with high probability; the memory requirement is O(k) values,
+ * independent of the number of values seen. Sketches can be merged.
+ */
+class KllSketch {
+public:
+  //! seed of the pseudo-random choice of the items promoted by each compaction
+  explicit KllSketch(unsigned k = 200, uint64_t seed = 0x6b6c6c);
+
+  void update(double value);
+  void update(std::span<double const> values);
+
+  //! fold the contents of another sketch into this one
+  void merge(KllSketch const& other);
+
+  //! approximate value at quantile q in [0, 1]
+  double quantile(double q) const;
+
+  //! total number of values seen
+  uint64_t count() const {
+    return n;
+  }
+
+  //! store the sketch as .npy file with the fields (level, value)
+  void save(std::filesystem::path const& path) const;
+
+  //! load a sketch stored with save()
+  static KllSketch load(std::filesystem::path const& path, unsigned k = 200);
+
+private:
+  size_t capacity(size_t level) const;
+  void add_level();
+  void compress();
+  bool coin_flip();
+
+  unsigned k;
+  uint64_t n{};
+  size_t size{}, max_size{};
+  uint64_t random_state;
+  std::vector<std::vector<double>> compactors;
+};
+
+/**
+ * Histogram with equally sized bins in [lower, upper) plus underflow and overflow bins.
+ * Histograms with identical binning can be merged.
+ */
+class Histogram {
+public:
+  Histogram(double lower, double upper, size_t bins);
+
+  void update(std::span<double const> values);
+
+  void merge(Histogram const& other);
+
+  //! counts of underflow bin, regular bins and overflow bin
+  std::span<uint64_t const> counts() const {
+    return bin_counts;
+  }
+
+  //! store the histogram as .npy file with the fields (lower_edge, count)
+  void save(std::filesystem::path const& path) const;
+
+  static Histogram load(std::filesystem::path const& path);
+
+private:
+  double lower, upper, scale;
+  std::vector<uint64_t> bin_counts;
+};
+
+//! configuration of the sketches maintained for one field of an NpyStream
+struct SketchOptions {
+  unsigned kll_k = 200;
+  struct Bins {
+    double lower, upper;
+    size_t count;
+  };
+  std::optional<Bins> histogram{}; //!< fixed-bin histogram, none by default
+};
+
+namespace detail {
+/**
+ * Maintains a quantile sketch, and optionally a histogram, of field k of the
+ * records written into a stream. Stored as "<file><suffix>.quantiles.npy" and
+ * "<file><suffix>.histogram.npy".
+ */
+template <tuple_like Tup, size_t k>
+class FieldSketch final : public RecordObserver {
+  using field_type = std::tuple_element_t<k, Tup>;
+  static_assert(std::is_arithmetic_v<field_type>, "sketches require arithmetic fields");
+
+public:
+  FieldSketch(SketchOptions const& options, std::string suffix)
+      : quantiles{options.kll_k}, suffix{std::move(suffix)} {
+    if (options.histogram) {
+      histogram.emplace(options.histogram->lower, options.histogram->upper,
+                        options.histogram->count);
+    }
+  }
+
+  void observe(char const* records, uint64_t count) override {
+    size_t constexpr record_size = tuple_info<Tup>::sum_sizes;
+    size_t constexpr offset = tuple_info<Tup>::offsets[k];
+    std::array<double, 256> values;
+
+    while (count > 0) {
+      size_t const n = static_cast<size_t>(std::min<uint64_t>(count, values.size()));
+      for (size_t i = 0; i < n; ++i) {
+        field_type v;
+        memcpy(&v, records + i * record_size + offset, sizeof(v));
+        values[i] = static_cast<double>(v);
+      }
+
+      std::span<double const> const batch{values.data(), n};
+      quantiles.update(batch);
+      if (histogram) {
+        histogram->update(batch);
+      }
+
+      records += n * record_size;
+      count -= n;
+    }
+  }
+
+  void finish(std::filesystem::path const& data_path) override {
+    quantiles.save(sidecar_path(data_path, suffix + ".quantiles.npy"));
+    if (histogram) {
+      histogram->save(sidecar_path(data_path, suffix + ".histogram.npy"));
+    }
+  }
+
+private:
+  KllSketch quantiles;
+  std::optional<Histogram> histogram;
+  std::string suffix;
+};
+} // namespace detail
+
+} // namespace npystream
@@ -0,0 +1,74 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include <npystream/huge_pages.hpp>
+
+namespace npystream::detail {
+
+//! deleter of StagingBuffer memory, which is either mapped or allocated with new[]
+struct ReleaseStaging {
+  size_t mapped_size{}; //!< 0 for memory allocated with new[]
+
+  void operator()(char* p) const noexcept {
+    if (mapped_size > 0) {
+      unmap_pages({p, mapped_size});
+    } else {
+      delete[] p;
+    }
+  }
+};
+
+/**
+ * Uninitialized memory for staging records before they are written. Buffers of at
+ * least own_pages_size are mapped separately instead of taken from the heap, whose
+ * pages may have been touched before, so that on NUMA systems the kernel places them on
+ * the node of the thread that first writes records into them (first touch), i.e. the
+ * producer, rather than on the node of the thread that created the stream. Buffers of
+ * at least huge_page_size are backed with huge pages according to the given policy,
+ * falling back to regular pages.
+ */
+class StagingBuffer {
+public:
+  StagingBuffer() = default;
+
+  explicit StagingBuffer(size_t size, HugePages huge_pages = HugePages::Transparent)
+      : size_{size} {
+    PageMapping mapping;
+    if (size >= huge_page_size) {
+      mapping = map_huge_pages(size, huge_pages);
+    }
+    if (mapping.data == nullptr && size >= own_pages_size) {
+      mapping = map_pages(size);
+    }
+    if (mapping.data != nullptr) {
+      memory = {mapping.data, ReleaseStaging{mapping.size}};
+    } else {
+      memory = {new char[size], ReleaseStaging{}};
+    }
+  }
+
+  char* data() const {
+    return memory.get();
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+private:
+  std::unique_ptr<char[], ReleaseStaging> memory;
+  size_t size_{};
+};
+
+} // namespace npystream::detail
@@ -0,0 +1,195 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <npystream/file_writer.hpp>
+#include <npystream/npy_header.hpp>
+#include <npystream/npystream.hpp>
+#include <npystream/repack.hpp>
+#include <npystream/tuple_util.hpp>
+
+namespace npystream {
+
+namespace detail {
+//! std::tuple of the field types of a record given as scalar or tuple-like value
+template <typename V>
+struct record_tuple {
+  using type = std::tuple<V>;
+};
+
+template <tuple_like V>
+struct record_tuple<V> {
+  using type = decltype([]<size_t... N>(std::index_sequence<N...>) {
+    return std::tuple<std::remove_cvref_t<std::tuple_element_t<N, V>>...>{};
+  }(std::make_index_sequence<std::tuple_size_v<V>>{}));
+};
+
+template <typename V>
+using record_tuple_t = typename record_tuple<V>::type;
+
+/**
+ * Write all records of a sized range with the final header up front: the file is
+ * preallocated and written sequentially, without a header rewrite at the end. If the
+ * range yields a different number of elements than its size(), the file is removed.
+ */
+template <std::ranges::sized_range R>
+uint64_t write_sized(R&& range, std::filesystem::path const& path,
+                     std::optional<std::vector<std::string>> const& field_labels) {
+  using value_type = std::ranges::range_value_t<R>;
+  using tuple_type = record_tuple_t<value_type>;
+  size_t constexpr record_size = tuple_info<tuple_type>::sum_sizes;
+  size_t constexpr chunk_records = std::max<size_t>(1, (1 << 16) / record_size);
+  uint64_t const count = std::ranges::size(range);
+
+  std::vector<std::string> labels;
+  if (field_labels) {
+    labels = *field_labels;
+  } else if constexpr (std::tuple_size_v<tuple_type> > 1) {
+    for (size_t i = 0; i < std::tuple_size_v<tuple_type>; ++i) {
+      labels.emplace_back(std::format("f{}", i));
+    }
+  }
+
+  std::vector<unsigned char> header;
+  std::span<uint64_t const> const shape(&count, 1);
+  if (labels.empty()) {
+    header = create_npy_header(shape, tuple_info<tuple_type>::data_types[0], record_size);
+  } else {
+    if (labels.size() != std::tuple_size_v<tuple_type>) {
+      throw std::runtime_error{
+          "labels size does not match number of elements in structured type"};
+    }
+    std::vector<std::string_view> const label_views(labels.cbegin(), labels.cend());
+    header = create_npy_header(shape, label_views, tuple_info<tuple_type>::data_types,
+                               tuple_info<tuple_type>::element_sizes, MemoryOrder::C);
+  }
+
+  FileWriter file{path};
+  file.preallocate(header.size() + count * record_size);
+  file.write(reinterpret_cast<char const*>(header.data()), header.size());
+
+  if constexpr (std::ranges::contiguous_range<R> && npy_serializable<value_type>) {
+    file.write(reinterpret_cast<char const*>(std::ranges::data(range)), count * record_size);
+  } else {
+    std::vector<char> chunk(std::min<uint64_t>(count, chunk_records) * record_size);
+    if constexpr (std::ranges::contiguous_range<R>) {
+      value_type const* src = std::ranges::data(range);
+      for (uint64_t done = 0; done < count;) {
+        size_t const n = static_cast<size_t>(std::min<uint64_t>(chunk_records, count - done));
+        repack(src + done, n, chunk.data());
+        file.write(chunk.data(), n * record_size);
+        done += n;
+      }
+    } else {
+      // the header is already written with count, so do not leave a file contradicting it
+      auto const discard = [&](char const* what) {
+        file.close();
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        throw std::runtime_error{std::format("to_npy: range yields {} elements than its size, "
+                                             "{} removed",
+                                             what, path.string())};
+      };
+
+      uint64_t written = 0;
+      size_t staged = 0;
+      for (auto&& val : range) {
+        if (written + staged == count) {
+          discard("more");
+        }
+        char* const dst = chunk.data() + staged * record_size;
+        if constexpr (npy_serializable<value_type>) {
+          value_type const v = val;
+          memcpy(dst, std::addressof(v), record_size);
+        } else {
+          serialize(val, dst);
+        }
+        if (++staged == chunk_records) {
+          file.write(chunk.data(), staged * record_size);
+          written += staged;
+          staged = 0;
+        }
+      }
+      file.write(chunk.data(), staged * record_size);
+      if (written + staged != count) {
+        discard("fewer");
+      }
+    }
+  }
+
+  file.close();
+  return count;
+}
+
+//! sink created by to_npy(), consumes a range with operator|
+struct ToNpy {
+  std::filesystem::path path;
+  std::optional<std::vector<std::string>> labels;
+
+  /**
+   * Consume the range into the file of the sink. For sized ranges the final header is
+   * written first and contiguous ranges are written in bulk; other ranges are written
+   * through an NpyStream.
+   */
+  template <std::ranges::input_range R>
+    requires npy_serializable<std::ranges::range_value_t<R>> ||
+             tuple_like<std::ranges::range_value_t<R>>
+  friend uint64_t operator|(R&& range, ToNpy const& sink) {
+    if constexpr (std::ranges::sized_range<R>) {
+      return write_sized(std::forward<R>(range), sink.path, sink.labels);
+    } else {
+      using stream_type = stream_for_t<record_tuple_t<std::ranges::range_value_t<R>>>;
+      stream_type stream =
+          sink.labels ? stream_type{sink.path, *sink.labels} : stream_type{sink.path};
+      uint64_t count = 0;
+      for (auto&& val : range) {
+        stream << val;
+        ++count;
+      }
+      stream.close();
+      return count;
+    }
+  }
+};
+} // namespace detail
+
+/**
+ * Range sink writing all elements of a range into a new .npy file, e.g.
+ * `auto n = values | std::views::filter(pred) | npystream::to_npy("out.npy");`.
+ * The elements are scalar or tuple-like values as for NpyStream, with labels
+ * f0, f1, ... for structured data. The expression yields the number of records written.
+ */
+inline detail::ToNpy to_npy(std::filesystem::path path) {
+  return {std::move(path), std::nullopt};
+}
+
+//! range sink writing structured records with the given field labels
+template <typename Container>
+detail::ToNpy to_npy(std::filesystem::path path, Container const& labels) {
+  return {std::move(path), std::vector<std::string>(std::cbegin(labels), std::cend(labels))};
+}
+
+} // namespace npystream
@@ -0,0 +1,67 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+/**
+ * Opt-in recorder of an I/O timeline (staging-buffer flushes, bulk writes, header
+ * rewrites, durability waits) in Chrome trace format, to be viewed in Perfetto or
+ * chrome://tracing. Each thread records into its own bounded ring buffer, which keeps
+ * the most recent events; while recording is off, a trace scope costs one relaxed
+ * atomic load.
+ */
+namespace npystream::trace {
+
+/**
+ * Start recording, keeping at most capacity_per_thread events per thread. The trace
+ * is written to path by stop(), or at process exit if stop() is not called.
+ */
+void start(std::filesystem::path const& path, size_t capacity_per_thread = 1 << 16);
+
+/**
+ * Stop recording and write the trace file. Events that threads are recording at this
+ * point, or overwrite in their ring buffer meanwhile, are left out.
+ */
+void stop();
+
+//! whether events are recorded currently
+bool enabled() noexcept;
+
+namespace detail {
+//! monotonic timestamp in nanoseconds, never 0
+uint64_t now() noexcept;
+
+void record(char const* name, uint64_t begin, uint64_t end, uint64_t bytes) noexcept;
+} // namespace detail
+
+/**
+ * Records the lifetime of the object as event with the given name, which has to be
+ * a string literal, and optionally the number of bytes processed.
+ */
+class Scope {
+public:
+  explicit Scope(char const* name, uint64_t bytes = 0) noexcept
+      : name{name}, bytes{bytes}, begin{enabled() ? detail::now() : 0} {}
+
+  Scope(Scope const&) = delete;
+  Scope& operator=(Scope const&) = delete;
+
+  ~Scope() {
+    if (begin) {
+      detail::record(name, begin, detail::now(), bytes);
+    }
+  }
+
+private:
+  char const* name;
+  uint64_t bytes;
+  uint64_t begin;
+};
+
+} // namespace npystream::trace
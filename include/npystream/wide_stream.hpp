@@ -0,0 +1,194 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <npystream/file_writer.hpp>
+#include <npystream/map_type.hpp>
+#include <npystream/npystream.hpp>
+#include <npystream/staging_buffer.hpp>
+
+namespace npystream {
+
+/**
+ * Handle to a .npy file of structured records that consist of a large number of
+ * fields of the same type T, e.g. feature vectors with thousands of labelled
+ * columns. The number of columns is chosen at runtime; rows are passed as
+ * std::span<T const> and copied as a whole.
+ */
+template <npy_serializable T>
+class WideNpyStream {
+public:
+  //! create a stream with the given number of columns, labelled f0, f1, ...
+  WideNpyStream(std::filesystem::path const& path, size_t columns)
+      : state{std::make_unique<State>()} {
+    state->labels.reserve(columns);
+    for (size_t i = 0; i < columns; ++i) {
+      state->labels.emplace_back(std::format("f{}", i));
+    }
+    init(FileWriter{path});
+  }
+
+  //! create a stream with one column per label
+  template <typename Container>
+  WideNpyStream(std::filesystem::path const& path, Container const& labels_)
+      : state{std::make_unique<State>()} {
+    state->labels.assign(std::cbegin(labels_), std::cend(labels_));
+    init(FileWriter{path});
+  }
+
+  WideNpyStream(WideNpyStream&&) noexcept = default;
+
+  //! complete the file of this stream and take over the other one, see NpyStream
+  WideNpyStream& operator=(WideNpyStream&& other) {
+    if (this != &other) {
+      finalize_quietly();
+      state = std::move(other.state);
+    }
+    return *this;
+  }
+
+  //! complete the file; errors are ignored here, use close() to have them reported
+  ~WideNpyStream() {
+    finalize_quietly();
+  }
+
+  /**
+   * Write pending records and the final header, and close the file. Errors are
+   * reported as exceptions; in any case, the stream is left in the moved-from state.
+   */
+  void close() {
+    if (!state) {
+      return;
+    }
+    try {
+      finalize();
+    } catch (...) {
+      state.reset();
+      throw;
+    }
+    state.reset();
+  }
+
+  size_t columns() const {
+    return state->labels.size();
+  }
+
+  //! write a single row, which has to consist of columns() values
+  WideNpyStream& operator<<(std::span<T const> row) {
+    State& s = *state;
+    if (row.size() != columns()) {
+      throw std::runtime_error{"WideNpyStream: row size does not match number of columns"};
+    }
+
+    // the buffer holds at least one row, see init()
+    size_t const row_size = row.size_bytes();
+    if (s.buffer.size() - s.buffer_used < row_size) {
+      flush_buffer();
+    }
+    memcpy(s.buffer.data() + s.buffer_used, row.data(), row_size);
+    s.buffer_used += row_size;
+    ++s.rows_written;
+    return *this;
+  }
+
+  /**
+   * write a batch of rows, given as consecutive values in row-major order. Pending
+   * rows and the batch are passed to the kernel in a single vectored write.
+   */
+  WideNpyStream& write(std::span<T const> rows) {
+    State& s = *state;
+    if (rows.size() % columns() != 0) {
+      throw std::runtime_error{"WideNpyStream: data size is not a multiple of the row size"};
+    }
+
+    std::array<ConstBuffer, 2> const pieces{
+        {{s.buffer.data(), s.buffer_used},
+         {reinterpret_cast<char const*>(rows.data()), rows.size_bytes()}}};
+    s.file.write(pieces);
+    s.buffer_used = 0;
+    s.rows_written += rows.size() / columns();
+    return *this;
+  }
+
+  void flush_buffer() {
+    State& s = *state;
+    s.file.write(s.buffer.data(), s.buffer_used);
+    s.buffer_used = 0;
+  }
+
+  //! write pending rows and update the header, see NpyStream::checkpoint()
+  void checkpoint() {
+    flush_buffer();
+    wrap_up(state->file, state->rows_written, state->header_end_pos, state->labels,
+            state->dtypes, state->sizes);
+  }
+
+  int native_handle() const {
+    return state->file.native_handle();
+  }
+
+private:
+  void finalize() {
+    checkpoint();
+    state->file.close();
+  }
+
+  void finalize_quietly() noexcept {
+    if (state) {
+      try {
+        finalize();
+      } catch (...) {
+      }
+    }
+  }
+
+  void init(FileWriter&& writer) {
+    State& s = *state;
+    if (s.labels.empty()) {
+      throw std::runtime_error{"WideNpyStream: at least one column is required"};
+    }
+
+    s.dtypes.assign(s.labels.size(), map_type(T{}));
+    s.sizes.assign(s.labels.size(), sizeof(T));
+
+    s.file = std::move(writer);
+    s.header_end_pos = begin_npy(s.file, s.labels, s.dtypes, s.sizes);
+    s.buffer = detail::StagingBuffer{std::max(buffer_size, sizeof(T) * s.labels.size())};
+  }
+
+  //! minimum size of the staging buffer
+  static size_t constexpr buffer_size = 1 << 16;
+
+  struct State {
+    FileWriter file;
+    size_t header_end_pos;
+    uint64_t rows_written{};
+    std::vector<std::string> labels;
+    std::vector<char> dtypes;
+    std::vector<size_t> sizes;
+    detail::StagingBuffer buffer;
+    size_t buffer_used{};
+  };
+
+  std::unique_ptr<State> state;
+};
+
+} // namespace npystream
@@ -0,0 +1,198 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <npystream/map_type.hpp>
+#include <npystream/mapped_file.hpp>
+#include <npystream/npy_header.hpp>
+#include <npystream/record_observer.hpp>
+#include <npystream/tuple_util.hpp>
+
+namespace npystream {
+
+/**
+ * Read access to the zone map of an .npy file, i.e. minimum and maximum of a
+ * number of fields per block of records, stored as "<file>.zonemap.npy" with the
+ * fields (first_record, <label>_min, <label>_max, ...).
+ */
+class ZoneMap {
+public:
+  explicit ZoneMap(std::filesystem::path const& path);
+
+  /**
+   * open the zone map belonging to the .npy file at data_path with the given number of
+   * records, if there is one that fits: zone maps that cannot be read, are older than
+   * the data file (e.g. left from an earlier file at the same path) or whose blocks do
+   * not cover exactly the records are ignored.
+   */
+  static std::optional<ZoneMap> open_for(std::filesystem::path const& data_path,
+                                         uint64_t records);
+
+  uint64_t blocks() const {
+    return header.shape[0];
+  }
+
+  //! index of the first record covered by the given block
+  uint64_t first_record(uint64_t block) const {
+    return load<uint64_t>(block, 0);
+  }
+
+  //! column holding the minimum of the field with the given label, if present
+  std::optional<size_t> column(std::string_view label) const;
+
+  //! minimum and maximum of the field stored in min_column (as returned by column())
+  template <typename T>
+  std::pair<T, T> range(uint64_t block, size_t min_column) const {
+    if (header.dtypes[min_column] != map_type(T{}) || header.sizes[min_column] != sizeof(T)) {
+      throw std::runtime_error{"ZoneMap: field type does not match"};
+    }
+    return {load<T>(block, min_column), load<T>(block, min_column + 1)};
+  }
+
+private:
+  //! whether the blocks are of equal size, except for the last, and hold exactly records
+  bool covers(uint64_t records) const;
+
+  template <typename T>
+  T load(uint64_t block, size_t column) const {
+    T val;
+    memcpy(&val, file.bytes().data() + header.data_offset + block * record_size + offsets[column],
+           sizeof(T));
+    return val;
+  }
+
+  MappedFile file;
+  NpyHeader header;
+  std::vector<size_t> offsets;
+  size_t record_size{};
+};
+
+namespace detail {
+/**
+ * Records minimum and maximum of the given fields for every block of records
+ * while they pass through the staging buffer.
+ */
+template <tuple_like Tup, size_t... Fields>
+class ZoneMapBuilder final : public RecordObserver {
+  static_assert(sizeof...(Fields) > 0);
+  static_assert((std::is_arithmetic_v<std::tuple_element_t<Fields, Tup>> && ...),
+                "zone maps require arithmetic fields");
+
+  using ranges_type = std::tuple<std::pair<std::tuple_element_t<Fields, Tup>,
+                                           std::tuple_element_t<Fields, Tup>>...>;
+  static size_t constexpr record_size = tuple_info<Tup>::sum_sizes;
+
+public:
+  ZoneMapBuilder(uint64_t block_records, std::span<std::string const> field_labels)
+      : block_records{block_records} {
+    if (block_records == 0) {
+      throw std::runtime_error{"ZoneMapBuilder: block size must not be zero"};
+    }
+
+    labels.emplace_back("first_record");
+    dtypes.push_back('u');
+    sizes.push_back(sizeof(uint64_t));
+    auto constexpr& field_dtypes = tuple_info<Tup>::data_types;
+    auto constexpr& field_sizes = tuple_info<Tup>::element_sizes;
+    for (size_t const k : {Fields...}) {
+      labels.push_back(field_labels[k] + "_min");
+      labels.push_back(field_labels[k] + "_max");
+      dtypes.insert(dtypes.end(), 2, field_dtypes[k]);
+      sizes.insert(sizes.end(), 2, field_sizes[k]);
+    }
+  }
+
+  void observe(char const* records, uint64_t count) override {
+    while (count > 0) {
+      uint64_t const n = std::min(count, block_records - in_block);
+      update(records, n, std::make_index_sequence<sizeof...(Fields)>{});
+      in_block += n;
+      records += n * record_size;
+      count -= n;
+
+      if (in_block == block_records) {
+        emit();
+      }
+    }
+  }
+
+  void finish(std::filesystem::path const& data_path) override {
+    if (in_block > 0) {
+      emit();
+    }
+    save_npy(sidecar_path(data_path, ".zonemap.npy"), labels, dtypes, sizes, output);
+  }
+
+private:
+  template <size_t... N>
+  void update(char const* records, uint64_t n, std::index_sequence<N...>) {
+    (update_field<N, Fields>(records, n), ...);
+  }
+
+  //! min/max of one field over n records; one pass per field keeps the loop simple
+  template <size_t N, size_t k>
+  void update_field(char const* records, uint64_t n) {
+    using field_type = std::tuple_element_t<k, Tup>;
+    size_t constexpr offset = tuple_info<Tup>::offsets[k];
+    auto& [lo, hi] = std::get<N>(ranges);
+
+    auto const at = [&](uint64_t i) {
+      field_type v;
+      memcpy(&v, records + i * record_size + offset, sizeof(v));
+      return v;
+    };
+
+    uint64_t i = 0;
+    if (in_block == 0) {
+      lo = hi = at(0);
+      i = 1;
+    }
+    for (; i < n; ++i) {
+      field_type const v = at(i);
+      lo = std::min(lo, v);
+      hi = std::max(hi, v);
+    }
+  }
+
+  void emit() {
+    auto const append = [this](auto const& value) {
+      auto const* bytes = reinterpret_cast<char const*>(std::addressof(value));
+      output.insert(output.end(), bytes, bytes + sizeof(value));
+    };
+
+    append(first_record);
+    std::apply(
+        [&](auto const&... range) { ((append(range.first), append(range.second)), ...); },
+        ranges);
+    first_record += in_block;
+    in_block = 0;
+  }
+
+  uint64_t block_records, in_block{}, first_record{};
+  ranges_type ranges{};
+  std::vector<std::string> labels;
+  std::vector<char> dtypes;
+  std::vector<size_t> sizes;
+  std::vector<char> output;
+};
+} // namespace detail
+
+} // namespace npystream
@@ -0,0 +1,145 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <npystream/bloom_filter.hpp>
+#include <npystream/npyreader.hpp>
+#include <npystream/npystream.hpp>
+
+namespace {
+uint64_t hash_key(uint64_t x) {
+  // finalizer of splitmix64
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+// odd multipliers deriving the eight bit positions within a block, as in Parquet's
+// split block Bloom filter
+std::array<uint32_t, 8> constexpr salts = {0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+                                           0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u};
+} // namespace
+
+npystream::BloomFilter::BloomFilter(uint64_t expected_keys, double bits_per_key)
+    : blocks(std::max<size_t>(
+          1, static_cast<size_t>(std::ceil(static_cast<double>(expected_keys) * bits_per_key /
+                                           (8 * sizeof(Block)))))) {}
+
+npystream::BloomFilter::Block npystream::BloomFilter::mask_of(uint64_t hash) {
+  Block mask;
+  uint32_t const x = static_cast<uint32_t>(hash);
+  for (size_t i = 0; i < mask.words.size(); ++i) {
+    mask.words[i] = uint64_t{1} << ((x * salts[i]) >> 26);
+  }
+  return mask;
+}
+
+size_t npystream::BloomFilter::block_index(uint64_t hash) const {
+  // map the upper 32 bits onto [0, blocks) without division
+  return static_cast<size_t>(((hash >> 32) * blocks.size()) >> 32);
+}
+
+void npystream::BloomFilter::insert(uint64_t key) {
+  uint64_t const hash = hash_key(key);
+  Block const mask = mask_of(hash);
+  Block& block = blocks[block_index(hash)];
+  for (size_t i = 0; i < block.words.size(); ++i) {
+    block.words[i] |= mask.words[i];
+  }
+}
+
+void npystream::BloomFilter::insert(std::span<uint64_t const> keys) {
+  for (uint64_t const key : keys) {
+    insert(key);
+  }
+}
+
+bool npystream::BloomFilter::may_contain(uint64_t key) const {
+  uint64_t const hash = hash_key(key);
+  Block const mask = mask_of(hash);
+  Block const& block = blocks[block_index(hash)];
+  uint64_t missing = 0;
+  for (size_t i = 0; i < block.words.size(); ++i) {
+    missing |= mask.words[i] & ~block.words[i];
+  }
+  return missing == 0;
+}
+
+void npystream::BloomFilter::merge(BloomFilter const& other) {
+  if (blocks.size() != other.blocks.size()) {
+    throw std::runtime_error{"BloomFilter: cannot merge filters of different size"};
+  }
+  for (size_t b = 0; b < blocks.size(); ++b) {
+    for (size_t i = 0; i < blocks[b].words.size(); ++i) {
+      blocks[b].words[i] |= other.blocks[b].words[i];
+    }
+  }
+}
+
+void npystream::BloomFilter::save(std::filesystem::path const& path) const {
+  NpyStream<uint64_t> stream{path};
+  stream.write(std::span{reinterpret_cast<uint64_t const*>(blocks.data()),
+                         blocks.size() * std::tuple_size_v<decltype(Block::words)>});
+  stream.close();
+}
+
+npystream::BloomFilter npystream::BloomFilter::load(std::filesystem::path const& path) {
+  NpyReader<uint64_t> const reader{path};
+  size_t constexpr words_per_block = std::tuple_size_v<decltype(Block::words)>;
+  if (reader.size() == 0 || reader.size() % words_per_block != 0) {
+    throw std::runtime_error{"BloomFilter: invalid filter file " + path.string()};
+  }
+
+  BloomFilter filter;
+  filter.blocks.resize(reader.size() / words_per_block);
+  std::copy_n(reader.data().data(), reader.data().size(),
+              reinterpret_cast<unsigned char*>(filter.blocks.data()));
+  return filter;
+}
+
+std::filesystem::path npystream::bloom_filter_path(std::filesystem::path const& data_path,
+                                                   std::string_view label) {
+  std::string suffix;
+  if (!label.empty()) {
+    suffix = ".";
+    suffix += label;
+  }
+  suffix += ".bloom.npy";
+  return sidecar_path(data_path, suffix);
+}
+
+npystream::BloomFilterSet::BloomFilterSet(std::span<std::filesystem::path const> data_files,
+                                          std::string_view label) {
+  filters.reserve(data_files.size());
+  for (auto const& data_path : data_files) {
+    auto const path = bloom_filter_path(data_path, label);
+    if (std::filesystem::exists(path)) {
+      filters.emplace_back(data_path, BloomFilter::load(path));
+    } else {
+      filters.emplace_back(data_path, std::nullopt);
+    }
+  }
+}
+
+std::vector<std::filesystem::path> npystream::BloomFilterSet::candidates(uint64_t key) const {
+  std::vector<std::filesystem::path> result;
+  for (auto const& [data_path, filter] : filters) {
+    if (!filter || filter->may_contain(key)) {
+      result.push_back(data_path);
+    }
+  }
+  return result;
+}
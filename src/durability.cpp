@@ -0,0 +1,138 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <npystream/durability.hpp>
+#include <npystream/trace.hpp>
+
+#ifdef _WIN32
+#  include <io.h>
+#else
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace {
+void sync_data(int fd) {
+#if defined(_WIN32)
+  int const result = _commit(fd);
+#elif defined(__APPLE__)
+  int const result = ::fsync(fd);
+#else
+  int const result = ::fdatasync(fd);
+#endif
+  if (result != 0) {
+    throw std::system_error{errno, std::generic_category(), "DurabilityManager: sync failed"};
+  }
+}
+} // namespace
+
+npystream::DurabilityManager::DurabilityManager(std::chrono::microseconds window, Method method)
+    : window{window}, method{method} {}
+
+void npystream::DurabilityManager::request(std::function<void()> checkpoint, int fd) {
+  Request req{std::move(checkpoint), fd};
+  trace::Scope const scope{"durability wait"};
+
+  std::unique_lock lock{mutex};
+  uint64_t const batch = open_batch;
+  pending.push_back(&req);
+
+  while (completed_batch < batch) {
+    if (!leader_active) {
+      lead(lock);
+    } else {
+      done.wait(lock);
+    }
+  }
+
+  if (req.error) {
+    std::rethrow_exception(req.error);
+  }
+}
+
+void npystream::DurabilityManager::lead(std::unique_lock<std::mutex>& lock) {
+  leader_active = true;
+  lock.unlock();
+  std::this_thread::sleep_for(window); // let other requests join the batch
+  lock.lock();
+
+  std::vector<Request*> batch = std::exchange(pending, {});
+  uint64_t const batch_number = open_batch++;
+  lock.unlock();
+
+  {
+    trace::Scope const scope{"durability batch"};
+    sync_batch(batch);
+  }
+
+  lock.lock();
+  completed_batch = batch_number;
+  leader_active = false;
+  done.notify_all();
+}
+
+void npystream::DurabilityManager::sync_batch(std::vector<Request*> const& batch) const {
+  // first bring all headers up to date, so that one sync covers data and header
+  for (Request* req : batch) {
+    try {
+      req->checkpoint();
+    } catch (...) {
+      req->error = std::current_exception();
+    }
+  }
+
+#ifdef __linux__
+  if (method == Method::FileSystem) {
+    std::vector<std::pair<dev_t, std::exception_ptr>> devices;
+    for (Request* req : batch) {
+      if (req->error) {
+        continue;
+      }
+
+      struct stat st;
+      if (::fstat(req->fd, &st) != 0) {
+        req->error = std::make_exception_ptr(
+            std::system_error{errno, std::generic_category(), "DurabilityManager: fstat failed"});
+        continue;
+      }
+
+      auto it = std::find_if(devices.begin(), devices.end(),
+                             [&](auto const& d) { return d.first == st.st_dev; });
+      if (it == devices.end()) {
+        std::exception_ptr error;
+        if (::syncfs(req->fd) != 0) {
+          error = std::make_exception_ptr(std::system_error{errno, std::generic_category(),
+                                                            "DurabilityManager: syncfs failed"});
+        }
+        it = devices.insert(devices.end(), {st.st_dev, error});
+      }
+      req->error = it->second;
+    }
+    return;
+  }
+#endif
+
+  for (Request* req : batch) {
+    if (req->error) {
+      continue;
+    }
+    try {
+      sync_data(req->fd);
+    } catch (...) {
+      req->error = std::current_exception();
+    }
+  }
+}
@@ -0,0 +1,251 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <npystream/file_writer.hpp>
+
+#ifdef _WIN32
+#  include <fcntl.h>
+#  include <io.h>
+#  include <sys/stat.h>
+#else
+#  include <climits>
+#  include <fcntl.h>
+#  include <sys/uio.h>
+#  include <unistd.h>
+#endif
+
+namespace {
+[[noreturn]] void throw_errno(char const* what) {
+  throw std::system_error{errno, std::generic_category(), what};
+}
+
+//! a write of a non-empty buffer that returns 0 would otherwise be retried forever
+[[noreturn]] void throw_no_progress(char const* what) {
+  throw std::system_error{EIO, std::generic_category(), what};
+}
+
+#ifdef _WIN32
+// largest chunk passed to a single _write() call
+unsigned constexpr max_chunk = 1u << 30;
+
+int64_t current_offset(int fd) {
+  return _lseeki64(fd, 0, SEEK_CUR);
+}
+
+long long write_some(int fd, char const* data, size_t size) {
+  return _write(fd, data, static_cast<unsigned>(std::min<size_t>(size, max_chunk)));
+}
+
+long long write_some_at(int fd, char const* data, size_t size, int64_t offset) {
+  int64_t const pos = _lseeki64(fd, 0, SEEK_CUR);
+  if (pos < 0 || _lseeki64(fd, offset, SEEK_SET) < 0) {
+    return -1;
+  }
+  long long const n = write_some(fd, data, size);
+  int const saved_errno = errno;
+  _lseeki64(fd, pos, SEEK_SET);
+  errno = saved_errno;
+  return n;
+}
+#else
+int64_t current_offset(int fd) {
+  return ::lseek(fd, 0, SEEK_CUR);
+}
+
+long long write_some(int fd, char const* data, size_t size) {
+  return ::write(fd, data, size);
+}
+
+long long write_some_at(int fd, char const* data, size_t size, int64_t offset) {
+  return ::pwrite(fd, data, size, static_cast<off_t>(offset));
+}
+#endif
+
+//! close descriptor, ignoring errors
+void close_quietly(int fd) {
+#ifdef _WIN32
+  _close(fd);
+#else
+  ::close(fd);
+#endif
+}
+} // namespace
+
+npystream::FileWriter::FileWriter(std::filesystem::path const& path, OpenMode mode) {
+  // no O_APPEND, which would redirect pwrite() to the end of the file on Linux
+#ifdef _WIN32
+  int const truncate = (mode == OpenMode::Truncate) ? _O_TRUNC : 0;
+  fd = _wopen(path.c_str(), _O_WRONLY | _O_CREAT | truncate | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+  int const truncate = (mode == OpenMode::Truncate) ? O_TRUNC : 0;
+  fd = ::open(path.c_str(), O_WRONLY | O_CREAT | truncate | O_CLOEXEC, 0666);
+#endif
+  if (fd < 0) {
+    throw std::system_error{errno, std::generic_category(),
+                            "FileWriter: could not open " + path.string()};
+  }
+  base_offset = 0;
+
+  if (mode == OpenMode::Append) {
+#ifdef _WIN32
+    bool const failed = _lseeki64(fd, 0, SEEK_END) < 0;
+#else
+    bool const failed = ::lseek(fd, 0, SEEK_END) < 0;
+#endif
+    if (failed) {
+      int const saved_errno = errno;
+      close_quietly(fd);
+      throw std::system_error{saved_errno, std::generic_category(),
+                              "FileWriter: could not seek in " + path.string()};
+    }
+  }
+}
+
+npystream::FileWriter::FileWriter(int fd_) : fd{fd_} {
+  if (fd < 0) {
+    throw std::system_error{EBADF, std::generic_category(), "FileWriter: invalid descriptor"};
+  }
+  base_offset = current_offset(fd);
+}
+
+npystream::FileWriter::FileWriter(FileWriter&& other) noexcept
+    : fd{std::exchange(other.fd, -1)}, base_offset{std::exchange(other.base_offset, -1)} {}
+
+npystream::FileWriter& npystream::FileWriter::operator=(FileWriter&& other) noexcept {
+  if (this != &other) {
+    if (fd >= 0) {
+      close_quietly(fd);
+    }
+    fd = std::exchange(other.fd, -1);
+    base_offset = std::exchange(other.base_offset, -1);
+  }
+  return *this;
+}
+
+npystream::FileWriter::~FileWriter() {
+  if (fd >= 0) {
+    close_quietly(fd);
+  }
+}
+
+void npystream::FileWriter::write(char const* data, size_t size) {
+  while (size > 0) {
+    long long const n = write_some(fd, data, size);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw_errno("FileWriter: write failed");
+    } else if (n == 0) {
+      throw_no_progress("FileWriter: write made no progress");
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+}
+
+void npystream::FileWriter::write(std::span<ConstBuffer const> buffers) {
+#ifdef _WIN32
+  for (auto const& buffer : buffers) {
+    write(buffer.data, buffer.size);
+  }
+#else
+  // the common case of a few pieces, e.g. the staging buffer followed by the caller's data,
+  // needs no allocation
+  std::array<iovec, 8> inline_iov;
+  std::vector<iovec> heap_iov;
+  iovec* iov = inline_iov.data();
+  if (buffers.size() > inline_iov.size()) {
+    heap_iov.resize(buffers.size());
+    iov = heap_iov.data();
+  }
+  size_t iov_count = 0;
+  for (auto const& buffer : buffers) {
+    if (buffer.size > 0) {
+      iov[iov_count++] = {const_cast<char*>(buffer.data), buffer.size};
+    }
+  }
+
+  size_t first = 0;
+  while (first < iov_count) {
+    int const count = static_cast<int>(std::min<size_t>(iov_count - first, IOV_MAX));
+    ssize_t n = ::writev(fd, iov + first, count);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw_errno("FileWriter: write failed");
+    } else if (n == 0) {
+      throw_no_progress("FileWriter: write made no progress");
+    }
+
+    // skip the completely written buffers and advance into a partially written one
+    for (; first < iov_count && static_cast<size_t>(n) >= iov[first].iov_len; ++first) {
+      n -= static_cast<ssize_t>(iov[first].iov_len);
+    }
+    if (first < iov_count) {
+      iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + n;
+      iov[first].iov_len -= static_cast<size_t>(n);
+    }
+  }
+#endif
+}
+
+void npystream::FileWriter::write_at(char const* data, size_t size, uint64_t offset) {
+  if (!seekable()) {
+    throw std::system_error{ESPIPE, std::generic_category(),
+                            "FileWriter: descriptor does not support positioned writes"};
+  }
+
+  int64_t pos = base_offset + static_cast<int64_t>(offset);
+  while (size > 0) {
+    long long const n = write_some_at(fd, data, size, pos);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw_errno("FileWriter: positioned write failed");
+    } else if (n == 0) {
+      throw_no_progress("FileWriter: positioned write made no progress");
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+    pos += n;
+  }
+}
+
+void npystream::FileWriter::preallocate([[maybe_unused]] uint64_t size) {
+#ifdef __linux__
+  if (seekable() && size > 0) {
+    ::fallocate(fd, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(base_offset),
+                static_cast<off_t>(size));
+  }
+#endif
+}
+
+void npystream::FileWriter::close() {
+  if (fd < 0) {
+    return;
+  }
+
+#ifdef _WIN32
+  int const result = _close(std::exchange(fd, -1));
+#else
+  int const result = ::close(std::exchange(fd, -1));
+#endif
+  if (result != 0 && errno != EINTR) {
+    throw_errno("FileWriter: close failed");
+  }
+}
@@ -0,0 +1,45 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include <npystream/flush_controller.hpp>
+
+npystream::FlushController::FlushController(AdaptiveFlush const& policy, size_t record_size)
+    : target_latency{policy.target_latency},
+      min_records{std::max<uint64_t>(1, policy.min_bytes / record_size)},
+      max_records{std::max<uint64_t>(1, policy.max_bytes / record_size)},
+      step_records{min_records}, threshold_records{min_records} {
+  if (policy.min_bytes > policy.max_bytes) {
+    throw std::runtime_error{"AdaptiveFlush: min_bytes exceeds max_bytes"};
+  }
+}
+
+void npystream::FlushController::update(size_t bytes, std::chrono::nanoseconds duration) {
+  // larger flushes need to gain at least this fraction of bandwidth to grow the threshold
+  double constexpr min_gain = 1.05;
+  // while the bandwidth has plateaued, every probe_interval-th flush grows it nonetheless
+  unsigned constexpr probe_interval = 16;
+
+  bool faster = true;
+  if (duration.count() > 0) {
+    double const sample = bytes / std::chrono::duration<double>{duration}.count();
+    faster = smoothed_bandwidth == 0 || sample > min_gain * smoothed_bandwidth;
+    smoothed_bandwidth = (smoothed_bandwidth == 0) ? sample
+                                                   : 0.75 * smoothed_bandwidth + 0.25 * sample;
+  }
+
+  if (duration > target_latency) {
+    threshold_records = std::max(min_records, threshold_records / 2);
+    // the bandwidth of the larger flushes is no reference for the smaller ones
+    smoothed_bandwidth = 0;
+    held_flushes = 0;
+  } else if (faster || ++held_flushes == probe_interval) {
+    threshold_records = std::min(max_records, threshold_records + step_records);
+    held_flushes = 0;
+  }
+}
@@ -0,0 +1,89 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#include <cstddef>
+#include <cstdint>
+
+#include <npystream/huge_pages.hpp>
+
+#ifdef __linux__
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+npystream::detail::PageMapping
+npystream::detail::map_huge_pages([[maybe_unused]] size_t size,
+                                  [[maybe_unused]] HugePages policy) {
+#ifdef __linux__
+  if (policy == HugePages::Off) {
+    return {};
+  }
+  size_t const length = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+
+#  ifdef MAP_HUGETLB
+  if (policy == HugePages::Reserved) {
+    void* const p = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+      return {static_cast<char*>(p), length};
+    }
+    // no reserved huge pages available, fall back to transparent huge pages
+  }
+#  endif
+
+  // over-allocate by one huge page and trim to an aligned range
+  void* const p = ::mmap(nullptr, length + huge_page_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    return {};
+  }
+  char* const raw = static_cast<char*>(p);
+  uintptr_t const address = reinterpret_cast<uintptr_t>(raw);
+  char* const aligned = raw + (huge_page_size - address % huge_page_size) % huge_page_size;
+  size_t const head = static_cast<size_t>(aligned - raw);
+  if (head > 0) {
+    ::munmap(raw, head);
+  }
+  if (huge_page_size - head > 0) {
+    ::munmap(aligned + length, huge_page_size - head);
+  }
+  advise_huge_pages(aligned, length);
+  return {aligned, length};
+#else
+  return {};
+#endif
+}
+
+npystream::detail::PageMapping npystream::detail::map_pages([[maybe_unused]] size_t size) {
+#ifdef __linux__
+  size_t const page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  size_t const length = (size + page - 1) / page * page;
+  void* const p =
+      ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p != MAP_FAILED) {
+    return {static_cast<char*>(p), length};
+  }
+#endif
+  return {};
+}
+
+void npystream::detail::unmap_pages([[maybe_unused]] PageMapping const& mapping) noexcept {
+#ifdef __linux__
+  if (mapping.data != nullptr) {
+    ::munmap(mapping.data, mapping.size);
+  }
+#endif
+}
+
+void npystream::detail::advise_huge_pages([[maybe_unused]] void const* data,
+                                          [[maybe_unused]] size_t size) noexcept {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  // madvise requires a page-aligned start; errors (e.g. THP disabled) are not fatal
+  uintptr_t const page = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+  uintptr_t const address = reinterpret_cast<uintptr_t>(data);
+  uintptr_t const start = address / page * page;
+  ::madvise(reinterpret_cast<void*>(start), size + (address - start), MADV_HUGEPAGE);
+#endif
+}
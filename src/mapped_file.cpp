@@ -0,0 +1,92 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <npystream/mapped_file.hpp>
+
+#ifdef _WIN32
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+npystream::MappedFile::MappedFile(std::filesystem::path const& path,
+                                  [[maybe_unused]] HugePages huge_pages) {
+  size_ = std::filesystem::file_size(path);
+  if (size_ == 0) {
+    return;
+  }
+
+#ifdef _WIN32
+  HANDLE const file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error{"MappedFile: could not open " + path.string()};
+  }
+  HANDLE const mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (mapping == nullptr) {
+    throw std::runtime_error{"MappedFile: could not map " + path.string()};
+  }
+  void const* const view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (view == nullptr) {
+    throw std::runtime_error{"MappedFile: could not map " + path.string()};
+  }
+#else
+  int const fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error{"MappedFile: could not open " + path.string()};
+  }
+  void* const view = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (view == MAP_FAILED) {
+    throw std::runtime_error{"MappedFile: could not map " + path.string()};
+  }
+  if (huge_pages != HugePages::Off && size_ >= detail::huge_page_size) {
+    detail::advise_huge_pages(view, size_);
+  }
+#endif
+
+  data_ = static_cast<unsigned char const*>(view);
+}
+
+npystream::MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_{std::exchange(other.data_, nullptr)}, size_{std::exchange(other.size_, 0)} {}
+
+npystream::MappedFile& npystream::MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    unmap();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+npystream::MappedFile::~MappedFile() {
+  unmap();
+}
+
+void npystream::MappedFile::unmap() noexcept {
+  if (data_ == nullptr) {
+    return;
+  }
+
+#ifdef _WIN32
+  UnmapViewOfFile(data_);
+#else
+  ::munmap(const_cast<unsigned char*>(data_), size_);
+#endif
+  data_ = nullptr;
+}
@@ -0,0 +1,260 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <npystream/mapped_file.hpp>
+#include <npystream/multiplexed_log.hpp>
+#include <npystream/npy_header.hpp>
+#include <npystream/numa.hpp>
+
+namespace {
+//! precedes each record in the log
+struct FrameHeader {
+  uint32_t stream;
+  uint32_t size;
+};
+} // namespace
+
+npystream::MultiplexedLog::MultiplexedLog(std::filesystem::path log_path_,
+                                          std::chrono::milliseconds interval, size_t buffer_bytes,
+                                          size_t max_open_files)
+    : log_path{std::move(log_path_)}, interval{interval}, buffer_bytes{buffer_bytes},
+      log{log_path}, buffer{std::max<size_t>(buffer_bytes, 1)},
+      max_open_files{std::max<size_t>(max_open_files, 1)} {
+  // the compactor writes all stream files, keep it close to the device of the log
+  std::optional<unsigned> const node =
+      (numa::node_count() > 1) ? numa::device_node(log_path) : std::nullopt;
+  compactor = std::jthread{[this, node](std::stop_token token) {
+    if (node) {
+      numa::pin_current_thread(*node);
+    }
+    run(token);
+  }};
+}
+
+npystream::MultiplexedLog::~MultiplexedLog() {
+  if (!closed) {
+    try {
+      close();
+    } catch (...) {
+      // destructors must not throw, errors are reported by close() only
+    }
+  }
+}
+
+uint32_t npystream::MultiplexedLog::add_stream(std::filesystem::path const& path,
+                                               std::vector<std::string> labels,
+                                               std::span<char const> dtypes,
+                                               std::span<size_t const> sizes) {
+  if (!labels.empty() && labels.size() != dtypes.size()) {
+    throw std::runtime_error{"labels size does not match number of elements in structured type"};
+  }
+
+  auto stream = std::make_unique<Stream>(Stream{path,
+                                                std::move(labels),
+                                                {dtypes.begin(), dtypes.end()},
+                                                {sizes.begin(), sizes.end()},
+                                                std::reduce(sizes.begin(), sizes.end())});
+
+  std::lock_guard lock{mutex};
+  if (streams.size() == std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error{"MultiplexedLog: too many streams"};
+  }
+  streams.push_back(std::move(stream));
+  return static_cast<uint32_t>(streams.size() - 1);
+}
+
+void npystream::MultiplexedLog::append(uint32_t stream, char const* record, size_t size) {
+  FrameHeader const header{stream, static_cast<uint32_t>(size)};
+  char const* const header_bytes = reinterpret_cast<char const*>(&header);
+
+  std::lock_guard lock{mutex};
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  size_t const frame_size = sizeof(header) + size;
+  if (buffer.size() - buffer_used < frame_size) {
+    flush_locked();
+  }
+  if (frame_size > buffer.size()) {
+    std::array<ConstBuffer, 2> const pieces{{{header_bytes, sizeof(header)}, {record, size}}};
+    log.write(pieces);
+    log_size += frame_size;
+    return;
+  }
+  memcpy(buffer.data() + buffer_used, header_bytes, sizeof(header));
+  memcpy(buffer.data() + buffer_used + sizeof(header), record, size);
+  buffer_used += frame_size;
+  if (buffer_used == buffer.size()) {
+    flush_locked();
+  }
+}
+
+void npystream::MultiplexedLog::flush_locked() {
+  if (buffer_used == 0) {
+    return;
+  }
+  log.write(buffer.data(), buffer_used);
+  log_size += buffer_used;
+  buffer_used = 0;
+}
+
+void npystream::MultiplexedLog::compact() {
+  compact(true);
+}
+
+void npystream::MultiplexedLog::compact(bool complete_files) {
+  std::lock_guard compaction_lock{compaction_mutex};
+
+  uint64_t end;
+  std::vector<Stream*> snapshot;
+  {
+    std::lock_guard lock{mutex};
+    flush_locked();
+    end = log_size;
+    snapshot.reserve(streams.size());
+    for (auto const& stream : streams) {
+      snapshot.push_back(stream.get());
+    }
+  }
+
+  if (end > compacted) {
+    compact_range(compacted, end, snapshot);
+    compacted = end;
+  }
+  if (complete_files) {
+    for (Stream* stream : open_files) {
+      update_header(*stream, stream->file);
+    }
+  }
+
+  // start the log over once everything in it has been compacted
+  std::lock_guard lock{mutex};
+  if (log_size == compacted && compacted > 0) {
+    log = FileWriter{log_path};
+    log_size = compacted = 0;
+    for (auto const& stream : streams) {
+      stream->log_end = 0;
+    }
+  }
+}
+
+void npystream::MultiplexedLog::compact_range(uint64_t begin, uint64_t end,
+                                              std::span<Stream* const> snapshot) {
+  MappedFile const file{log_path};
+  auto const bytes = file.bytes().subspan(begin, end - begin);
+
+  std::unordered_map<uint32_t, std::vector<char>> records;
+  for (size_t pos = 0; pos < bytes.size();) {
+    FrameHeader header;
+    memcpy(&header, bytes.data() + pos, sizeof(header));
+    // frames before log_end were written by an earlier compaction that failed later on
+    if (begin + pos >= snapshot[header.stream]->log_end) {
+      auto& data = records[header.stream];
+      data.insert(data.end(), bytes.data() + pos + sizeof(header),
+                  bytes.data() + pos + sizeof(header) + header.size);
+    }
+    pos += sizeof(header) + header.size;
+  }
+
+  for (auto const& [id, data] : records) {
+    Stream& stream = *snapshot[id];
+    // positioned write, so that a write failing halfway is overwritten by the next attempt
+    open_file(stream).write_at(data.data(), data.size(),
+                               stream.header_end_pos + stream.records * stream.record_size);
+    stream.records += data.size() / stream.record_size;
+    stream.log_end = end;
+  }
+}
+
+npystream::FileWriter& npystream::MultiplexedLog::open_file(Stream& stream) {
+  if (stream.file.is_open()) {
+    open_files.splice(open_files.begin(), open_files, stream.lru_position);
+    return stream.file;
+  }
+
+  if (open_files.size() >= max_open_files) {
+    close_file(*open_files.back());
+  }
+  if (stream.header_end_pos == 0) {
+    FileWriter file{stream.path};
+    stream.header_end_pos = begin_npy(file, stream.labels, stream.dtypes, stream.sizes);
+    stream.file = std::move(file);
+  } else {
+    stream.file = FileWriter{stream.path, FileWriter::OpenMode::Append};
+  }
+  open_files.push_front(&stream);
+  stream.lru_position = open_files.begin();
+  return stream.file;
+}
+
+void npystream::MultiplexedLog::update_header(Stream& stream, FileWriter& file) {
+  if (stream.header_records != stream.records) {
+    wrap_up(file, stream.records, stream.header_end_pos, stream.labels, stream.dtypes,
+            stream.sizes);
+    stream.header_records = stream.records;
+  }
+}
+
+void npystream::MultiplexedLog::close_file(Stream& stream) {
+  open_files.erase(stream.lru_position);
+  FileWriter file = std::move(stream.file); // out of open_files even if the update fails
+  update_header(stream, file);
+  file.close();
+}
+
+void npystream::MultiplexedLog::run(std::stop_token token) {
+  std::unique_lock lock{mutex};
+  while (!wakeup.wait_for(lock, token, interval, [] { return false; }) &&
+         !token.stop_requested()) {
+    lock.unlock();
+    try {
+      compact(false);
+    } catch (...) {
+      lock.lock();
+      error = std::current_exception();
+      return;
+    }
+    lock.lock();
+  }
+}
+
+void npystream::MultiplexedLog::close() {
+  closed = true;
+  compactor.request_stop();
+  if (compactor.joinable()) {
+    compactor.join();
+  }
+
+  {
+    std::lock_guard lock{mutex};
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  compact(false);
+  {
+    std::lock_guard compaction_lock{compaction_mutex};
+    while (!open_files.empty()) {
+      close_file(*open_files.front());
+    }
+  }
+  std::lock_guard lock{mutex};
+  log.close();
+  std::filesystem::remove(log_path);
+}
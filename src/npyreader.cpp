@@ -0,0 +1,250 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <npystream/npyreader.hpp>
+
+namespace {
+/**
+ * Minimal parser for the Python literal dictionary contained in .npy headers.
+ * Only the subset produced by numpy (strings, booleans, integers, tuples and
+ * lists thereof) is understood.
+ */
+class DictParser {
+public:
+  explicit DictParser(std::string_view text) : text{text} {}
+
+  npystream::NpyHeader parse() {
+    npystream::NpyHeader header;
+    bool has_descr = false, has_shape = false;
+
+    expect('{');
+    while (!consume('}')) {
+      std::string const key = string();
+      expect(':');
+
+      if (key == "descr") {
+        descr(header);
+        has_descr = true;
+      } else if (key == "fortran_order") {
+        header.memory_order =
+            boolean() ? npystream::MemoryOrder::Fortran : npystream::MemoryOrder::C;
+      } else if (key == "shape") {
+        expect('(');
+        while (!consume(')')) {
+          header.shape.push_back(integer());
+          consume(',');
+        }
+        has_shape = true;
+      } else {
+        fail("unknown key");
+      }
+
+      consume(',');
+    }
+
+    if (!has_descr || !has_shape) {
+      fail("missing key");
+    }
+    return header;
+  }
+
+private:
+  void descr(npystream::NpyHeader& header) {
+    if (peek() != '[') {
+      type(string(), header);
+      return;
+    }
+
+    expect('[');
+    while (!consume(']')) {
+      expect('(');
+      header.labels.push_back(string());
+      expect(',');
+      type(string(), header);
+      if (!consume(')')) {
+        fail("sub-array fields are not supported");
+      }
+      consume(',');
+    }
+  }
+
+  void type(std::string_view typestr, npystream::NpyHeader& header) {
+    if (typestr.size() < 3) {
+      fail("invalid type string");
+    }
+
+    char const order = typestr[0];
+    char const native = (std::endian::native == std::endian::little) ? '<' : '>';
+    size_t size = 0;
+    for (char const c : typestr.substr(2)) {
+      if (!std::isdigit(static_cast<unsigned char>(c))) {
+        fail("invalid type string");
+      }
+      size = size * 10 + static_cast<size_t>(c - '0');
+    }
+
+    if (order != native && order != '|' && order != '=' && size > 1) {
+      fail("non-native byte order is not supported");
+    }
+
+    header.dtypes.push_back(typestr[1]);
+    header.sizes.push_back(size);
+  }
+
+  std::string string() {
+    skip_space();
+    char const quote = next();
+    if (quote != '\'' && quote != '"') {
+      fail("expected string");
+    }
+    std::string s;
+    for (char c = next(); c != quote; c = next()) {
+      s.push_back(c);
+    }
+    return s;
+  }
+
+  bool boolean() {
+    skip_space();
+    if (text.substr(pos).starts_with("True")) {
+      pos += 4;
+      return true;
+    } else if (text.substr(pos).starts_with("False")) {
+      pos += 5;
+      return false;
+    }
+    fail("expected boolean");
+  }
+
+  uint64_t integer() {
+    skip_space();
+    if (pos >= text.size() || !std::isdigit(static_cast<unsigned char>(text[pos]))) {
+      fail("expected integer");
+    }
+    uint64_t value = 0;
+    while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos]))) {
+      value = value * 10 + static_cast<uint64_t>(text[pos++] - '0');
+    }
+    if (pos < text.size() && text[pos] == 'L') { // Python 2 long suffix
+      ++pos;
+    }
+    return value;
+  }
+
+  char peek() {
+    skip_space();
+    return pos < text.size() ? text[pos] : '\0';
+  }
+
+  char next() {
+    if (pos >= text.size()) {
+      fail("unexpected end of header");
+    }
+    return text[pos++];
+  }
+
+  bool consume(char c) {
+    if (peek() == c) {
+      ++pos;
+      return true;
+    }
+    return false;
+  }
+
+  void expect(char c) {
+    if (!consume(c)) {
+      fail(std::string{"expected '"} + c + "'");
+    }
+  }
+
+  void skip_space() {
+    while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+      ++pos;
+    }
+  }
+
+  [[noreturn]] void fail(std::string const& what) const {
+    throw std::runtime_error{"parse_npy_header: " + what + " at position " + std::to_string(pos)};
+  }
+
+  std::string_view text;
+  size_t pos{};
+};
+} // namespace
+
+npystream::NpyHeader npystream::parse_npy_header(std::span<unsigned char const> bytes) {
+  static unsigned char constexpr magic[] = {0x93, 'N', 'U', 'M', 'P', 'Y'};
+
+  if (bytes.size() < 10 || !std::equal(std::begin(magic), std::end(magic), bytes.begin())) {
+    throw std::runtime_error{"parse_npy_header: not an .npy file"};
+  }
+
+  unsigned char const major_version = bytes[6];
+  size_t dict_begin, dict_length;
+  if (major_version == 1) {
+    dict_begin = 10;
+    dict_length = bytes[8] | (size_t{bytes[9]} << 8);
+  } else if (major_version == 2 || major_version == 3) {
+    if (bytes.size() < 12) {
+      throw std::runtime_error{"parse_npy_header: truncated header"};
+    }
+    dict_begin = 12;
+    dict_length = bytes[8] | (size_t{bytes[9]} << 8) | (size_t{bytes[10]} << 16) |
+                  (size_t{bytes[11]} << 24);
+  } else {
+    throw std::runtime_error{"parse_npy_header: unsupported format version"};
+  }
+
+  if (bytes.size() < dict_begin + dict_length) {
+    throw std::runtime_error{"parse_npy_header: truncated header"};
+  }
+
+  std::string_view const dict{reinterpret_cast<char const*>(bytes.data()) + dict_begin,
+                              dict_length};
+  NpyHeader header = DictParser{dict}.parse();
+  header.data_offset = dict_begin + dict_length;
+  return header;
+}
+
+npystream::NpyHeader npystream::read_npy_header(std::filesystem::path const& path) {
+  std::ifstream file{path, std::ios::binary};
+  if (!file) {
+    throw std::runtime_error{"read_npy_header: could not open " + path.string()};
+  }
+
+  // the preamble (magic, version, dictionary length) takes 10 or 12 bytes
+  std::vector<unsigned char> bytes(12);
+  file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+  bytes.resize(static_cast<size_t>(file.gcount()));
+
+  if (bytes.size() >= 10) {
+    size_t dict_end = 10 + (bytes[8] | (size_t{bytes[9]} << 8));
+    if (bytes[6] >= 2 && bytes.size() == 12) {
+      dict_end = 12 + (bytes[8] | (size_t{bytes[9]} << 8) | (size_t{bytes[10]} << 16) |
+                       (size_t{bytes[11]} << 24));
+    }
+    if (dict_end > bytes.size()) {
+      size_t const preamble_read = bytes.size();
+      bytes.resize(dict_end);
+      file.read(reinterpret_cast<char*>(bytes.data()) + preamble_read,
+                static_cast<std::streamsize>(dict_end - preamble_read));
+      bytes.resize(preamble_read + static_cast<size_t>(file.gcount()));
+    }
+  }
+
+  return parse_npy_header(bytes);
+}
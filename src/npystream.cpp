@@ -3,10 +3,13 @@
 // see LICENSE file
 // SPDX-License-Identifier: EUPL-1.2
 
+#include <algorithm>
 #include <bit>
 #include <concepts>
 #include <cstring>
-#include <fstream>
+#include <iterator>
+#include <limits>
+#include <numeric>
 #include <span>
 #include <string_view>
 #include <vector>
@@ -16,31 +19,6 @@
 static_assert(std::endian::native == std::endian::big || std::endian::native == std::endian::little,
               "mixed-endianness not supported");
 
-void npystream::wrap_up(std::ofstream& file, uint64_t values_written, size_t header_end_pos,
-                        std::span<std::string const> labels, std::span<char const> dtypes,
-                        std::span<size_t const> element_sizes) {
-  std::vector<unsigned char> updated_header;
-  if (labels.size() == 0) {
-    updated_header =
-        create_npy_header(std::span<uint64_t>(&values_written, 1), dtypes[0], element_sizes[0]);
-  } else {
-    std::vector<std::string_view> label_views(labels.begin(), labels.end());
-    updated_header = create_npy_header(std::span<uint64_t const>(&values_written, 1), label_views,
-                                       dtypes, element_sizes, MemoryOrder::C);
-  }
-
-  uint64_t const len_missing_padding = header_end_pos - updated_header.size();
-  updated_header.insert(std::prev(updated_header.end()),
-                        std::max(static_cast<uint64_t>(0), len_missing_padding), ' ');
-  uint8_t& len_upper = *reinterpret_cast<uint8_t*>(&updated_header[7]);
-  uint8_t& len_lower = *reinterpret_cast<uint8_t*>(&updated_header[8]);
-  len_upper = static_cast<uint8_t>((updated_header.size() - 10u) / 0x100u);
-  len_lower = static_cast<uint8_t>((updated_header.size() - 10u) % 0x100u);
-  assert(updated_header.size() == header_end_pos);
-  file.seekp(0);
-  file.write(reinterpret_cast<char*>(updated_header.data()), updated_header.size());
-}
-
 static std::vector<unsigned char>& append(std::vector<unsigned char>& vec, std::string_view view) {
   vec.insert(vec.end(), view.begin(), view.end());
   return vec;
@@ -62,23 +40,39 @@ static std::vector<unsigned char>& append(std::vector<unsigned char>& lhs, const
   return lhs;
 }
 
+//! magic string, format version and dictionary length; version 2.0 for dictionaries > 64 KiB
+static std::vector<unsigned char> create_preamble(size_t dict_size) {
+  std::vector<unsigned char> header;
+  header.push_back((unsigned char)0x93);
+  append(header, "NUMPY");
+  if (dict_size <= 0xffff) {
+    header.push_back((unsigned char)0x01); // major version of numpy format
+    header.push_back((unsigned char)0x00); // minor version of numpy format
+    append(header, (uint16_t)dict_size);
+  } else {
+    header.push_back((unsigned char)0x02);
+    header.push_back((unsigned char)0x00);
+    append(header, (uint32_t)dict_size);
+  }
+  return header;
+}
+
 static std::vector<unsigned char> finalize_header(std::vector<unsigned char> dict) {
   // pad with spaces so that preamble+dict is modulo 16 bytes. preamble is 10
-  // bytes. dict needs to end with \n
-  int const remainder = 16 - (10 + dict.size()) % 16;
+  // bytes (12 bytes for format version 2.0). dict needs to end with \n
+  size_t preamble_size = 10;
+  if (dict.size() + 16 - (preamble_size + dict.size()) % 16 > 0xffff) {
+    preamble_size = 12;
+  }
+  int const remainder = 16 - (preamble_size + dict.size()) % 16;
   dict.insert(dict.end(), remainder, ' ');
   dict.back() = '\n';
 
-  if (dict.size() > 0xffff) {
+  if (dict.size() > 0xffffffff) {
     throw std::runtime_error{"dictionary too large for .npy header"};
   }
 
-  std::vector<unsigned char> header;
-  header.push_back((unsigned char)0x93);
-  append(header, "NUMPY");
-  header.push_back((unsigned char)0x01); // major version of numpy format
-  header.push_back((unsigned char)0x00); // minor version of numpy format
-  append(header, (uint16_t)dict.size());
+  std::vector<unsigned char> header = create_preamble(dict.size());
   header.insert(header.end(), dict.begin(), dict.end());
 
   return header;
@@ -158,3 +152,81 @@ std::vector<unsigned char> npystream::create_npy_header(std::span<uint64_t const
 
   return finalize_header(std::move(dict));
 }
+
+size_t npystream::begin_npy(FileWriter& file, std::span<std::string const> labels,
+                            std::span<char const> dtypes, std::span<size_t const> element_sizes) {
+  uint64_t const max_elements = std::numeric_limits<uint64_t>::max();
+  std::span<uint64_t const> const shape(&max_elements, 1);
+  std::vector<unsigned char> header;
+  if (labels.size() == 0) {
+    header = create_npy_header(shape, dtypes[0], element_sizes[0]);
+  } else {
+    std::vector<std::string_view> const label_views(labels.begin(), labels.end());
+    header = create_npy_header(shape, label_views, dtypes, element_sizes, MemoryOrder::C);
+  }
+
+  if (file.seekable()) {
+    std::fill(std::next(header.begin(), 8), header.end(), 0);
+  }
+  file.write(reinterpret_cast<char const*>(header.data()), header.size());
+  return header.size();
+}
+
+void npystream::wrap_up(FileWriter& file, uint64_t values_written, size_t header_end_pos,
+                        std::span<std::string const> labels, std::span<char const> dtypes,
+                        std::span<size_t const> element_sizes) {
+  if (!file.seekable()) {
+    return; // pipe or socket, the header cannot be updated
+  }
+  NPYSTREAM_PROBE2(header_entry, file.native_handle(), values_written);
+  trace::Scope const scope{"wrap_up"};
+
+  std::vector<unsigned char> updated_header;
+  if (labels.size() == 0) {
+    updated_header =
+        create_npy_header(std::span<uint64_t>(&values_written, 1), dtypes[0], element_sizes[0]);
+  } else {
+    std::vector<std::string_view> label_views(labels.begin(), labels.end());
+    updated_header = create_npy_header(std::span<uint64_t const>(&values_written, 1), label_views,
+                                       dtypes, element_sizes, MemoryOrder::C);
+  }
+
+  // keep the size of the original header by padding the dictionary with spaces
+  size_t const preamble_size = (updated_header[6] == 1) ? 10 : 12;
+  std::vector<unsigned char> dict(std::next(updated_header.begin(), preamble_size),
+                                  updated_header.end());
+  size_t const target_preamble_size = (header_end_pos - 10 <= 0xffff) ? 10 : 12;
+  assert(dict.size() <= header_end_pos - target_preamble_size);
+  dict.pop_back();
+  dict.resize(header_end_pos - target_preamble_size - 1, ' ');
+  dict.push_back('\n');
+
+  updated_header = create_preamble(dict.size());
+  updated_header.insert(updated_header.end(), dict.begin(), dict.end());
+  assert(updated_header.size() == header_end_pos);
+  file.write_at(reinterpret_cast<char*>(updated_header.data()), updated_header.size(), 0);
+  NPYSTREAM_PROBE1(header_return, file.native_handle());
+}
+
+void npystream::save_npy(std::filesystem::path const& path, std::span<std::string const> labels,
+                         std::span<char const> dtypes, std::span<size_t const> sizes,
+                         std::span<char const> records) {
+  size_t const record_size = std::reduce(sizes.begin(), sizes.end());
+  if (record_size == 0 || records.size() % record_size != 0) {
+    throw std::runtime_error{"save_npy: data size is not a multiple of the record size"};
+  }
+
+  uint64_t const count = records.size() / record_size;
+  std::vector<std::string_view> const label_views(labels.begin(), labels.end());
+  auto const header = create_npy_header(std::span<uint64_t const>(&count, 1), label_views, dtypes,
+                                        sizes, MemoryOrder::C);
+
+  FileWriter file{path};
+  file.write(reinterpret_cast<char const*>(header.data()), header.size());
+  file.write(records.data(), records.size());
+  file.close();
+}
+
+static_assert(sizeof(npystream::NpyStream<double>) == sizeof(void*) &&
+                  sizeof(npystream::NpyStream<int, float, char>) == sizeof(void*),
+              "NpyStream is meant to be a single pointer to its heap-resident state");
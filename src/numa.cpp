@@ -0,0 +1,145 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <system_error>
+
+#include <npystream/numa.hpp>
+
+#ifdef __linux__
+#  include <sched.h>
+#  include <sys/stat.h>
+#  include <sys/syscall.h>
+#  include <sys/sysmacros.h>
+#  include <unistd.h>
+#endif
+
+#ifdef __linux__
+namespace {
+std::filesystem::path const node_root{"/sys/devices/system/node"};
+
+//! contents of a sysfs node, e.g. "0" or "-1" for numa_node files
+std::optional<std::string> read_sysfs(std::filesystem::path const& file) {
+  std::ifstream in{file};
+  std::string line;
+  if (!in || !std::getline(in, line)) {
+    return std::nullopt;
+  }
+  return line;
+}
+
+std::optional<unsigned> parse_node(std::filesystem::path const& file) {
+  auto const value = read_sysfs(file);
+  if (!value || value->empty() || value->front() == '-') {
+    return std::nullopt;
+  }
+  try {
+    return static_cast<unsigned>(std::stoul(*value));
+  } catch (std::exception const&) {
+    return std::nullopt;
+  }
+}
+} // namespace
+#endif
+
+unsigned npystream::numa::node_count() {
+#ifdef __linux__
+  unsigned count = 0;
+  std::error_code ec;
+  while (std::filesystem::exists(node_root / ("node" + std::to_string(count)), ec)) {
+    ++count;
+  }
+  return count == 0 ? 1 : count;
+#else
+  return 1;
+#endif
+}
+
+std::optional<unsigned> npystream::numa::current_node() {
+#ifdef __linux__
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+    return std::nullopt;
+  }
+  return node;
+#else
+  return std::nullopt;
+#endif
+}
+
+std::optional<unsigned>
+npystream::numa::device_node([[maybe_unused]] std::filesystem::path const& path) {
+#ifdef __linux__
+  // the file may not exist yet, its directory determines the device
+  std::filesystem::path target = std::filesystem::absolute(path);
+  struct stat st;
+  while (::stat(target.c_str(), &st) != 0) {
+    if (!target.has_relative_path()) {
+      return std::nullopt;
+    }
+    target = target.parent_path();
+  }
+
+  std::error_code ec;
+  std::filesystem::path const device = std::filesystem::canonical(
+      std::format("/sys/dev/block/{}:{}", major(st.st_dev), minor(st.st_dev)), ec);
+  if (ec) {
+    return std::nullopt;
+  }
+
+  // partitions and virtual devices inherit the node of the closest ancestor that has one,
+  // e.g. .../0000:01:00.0/nvme/nvme0/nvme0n1/nvme0n1p1 -> .../0000:01:00.0/numa_node
+  for (std::filesystem::path dir = device; dir.has_relative_path() && dir != "/sys/devices";
+       dir = dir.parent_path()) {
+    if (auto const node = parse_node(dir / "numa_node")) {
+      return node;
+    }
+    if (auto const node = parse_node(dir / "device" / "numa_node")) {
+      return node;
+    }
+  }
+#endif
+  return std::nullopt;
+}
+
+bool npystream::numa::pin_current_thread([[maybe_unused]] unsigned node) {
+#ifdef __linux__
+  auto const cpulist = read_sysfs(node_root / ("node" + std::to_string(node)) / "cpulist");
+  if (!cpulist) {
+    return false;
+  }
+
+  // format: comma-separated CPU numbers and ranges, e.g. "0-7,16-23"
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  try {
+    for (size_t pos = 0; pos < cpulist->size();) {
+      size_t const end = std::min(cpulist->find(',', pos), cpulist->size());
+      std::string const range = cpulist->substr(pos, end - pos);
+      size_t const dash = range.find('-');
+      unsigned long const first = std::stoul(range.substr(0, dash));
+      unsigned long const last =
+          (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+      for (unsigned long cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) {
+        CPU_SET(cpu, &cpus);
+      }
+      pos = end + 1;
+    }
+  } catch (std::exception const&) {
+    return false;
+  }
+
+  return CPU_COUNT(&cpus) > 0 && sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,215 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <npystream/npyreader.hpp>
+#include <npystream/npystream.hpp>
+#include <npystream/sketch.hpp>
+
+npystream::KllSketch::KllSketch(unsigned k, uint64_t seed)
+    : k{std::max(k, 8u)}, random_state{seed} {
+  add_level();
+}
+
+size_t npystream::KllSketch::capacity(size_t level) const {
+  size_t const depth = compactors.size() - level - 1;
+  return std::max<size_t>(2, static_cast<size_t>(std::ceil(k * std::pow(2. / 3., depth))));
+}
+
+void npystream::KllSketch::add_level() {
+  compactors.emplace_back();
+  max_size = 0;
+  for (size_t h = 0; h < compactors.size(); ++h) {
+    max_size += capacity(h);
+  }
+}
+
+bool npystream::KllSketch::coin_flip() {
+  // splitmix64
+  uint64_t x = (random_state += 0x9e3779b97f4a7c15ull);
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return (x ^ (x >> 31)) >> 63;
+}
+
+void npystream::KllSketch::compress() {
+  for (size_t h = 0; h < compactors.size(); ++h) {
+    if (compactors[h].size() < capacity(h)) {
+      continue;
+    }
+    if (h + 1 == compactors.size()) {
+      add_level();
+    }
+
+    auto& level = compactors[h];
+    auto& next = compactors[h + 1];
+    std::sort(level.begin(), level.end());
+
+    // promote every other item of an even-sized prefix, keep an odd one out in place
+    size_t const even = level.size() & ~size_t{1};
+    for (size_t i = coin_flip() ? 1 : 0; i < even; i += 2) {
+      next.push_back(level[i]);
+    }
+    level.erase(level.begin(), level.begin() + static_cast<std::ptrdiff_t>(even));
+    size -= even / 2;
+    return;
+  }
+}
+
+void npystream::KllSketch::update(double value) {
+  compactors[0].push_back(value);
+  ++size;
+  ++n;
+  while (size >= max_size) {
+    compress();
+  }
+}
+
+void npystream::KllSketch::update(std::span<double const> values) {
+  for (double const v : values) {
+    update(v);
+  }
+}
+
+void npystream::KllSketch::merge(KllSketch const& other) {
+  while (compactors.size() < other.compactors.size()) {
+    add_level();
+  }
+  for (size_t h = 0; h < other.compactors.size(); ++h) {
+    compactors[h].insert(compactors[h].end(), other.compactors[h].cbegin(),
+                         other.compactors[h].cend());
+  }
+  size += other.size;
+  n += other.n;
+  while (size >= max_size) {
+    compress();
+  }
+}
+
+double npystream::KllSketch::quantile(double q) const {
+  std::vector<std::pair<double, uint64_t>> weighted;
+  weighted.reserve(size);
+  for (size_t h = 0; h < compactors.size(); ++h) {
+    for (double const v : compactors[h]) {
+      weighted.emplace_back(v, uint64_t{1} << h);
+    }
+  }
+  if (weighted.empty()) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  std::sort(weighted.begin(), weighted.end());
+  double const target = std::clamp(q, 0., 1.) * static_cast<double>(n);
+  uint64_t cumulative = 0;
+  for (auto const& [value, weight] : weighted) {
+    cumulative += weight;
+    if (static_cast<double>(cumulative) >= target) {
+      return value;
+    }
+  }
+  return weighted.back().first;
+}
+
+void npystream::KllSketch::save(std::filesystem::path const& path) const {
+  NpyStream<uint32_t, double> stream{path, std::array{"level", "value"}};
+  for (size_t h = 0; h < compactors.size(); ++h) {
+    for (double const v : compactors[h]) {
+      stream << std::tuple{static_cast<uint32_t>(h), v};
+    }
+  }
+  stream.close();
+}
+
+npystream::KllSketch npystream::KllSketch::load(std::filesystem::path const& path, unsigned k) {
+  NpyReader<uint32_t, double> const reader{path};
+  KllSketch sketch{k};
+  for (uint64_t i = 0; i < reader.size(); ++i) {
+    auto const [level, value] = reader[i];
+    while (sketch.compactors.size() <= level) {
+      sketch.add_level();
+    }
+    sketch.compactors[level].push_back(value);
+    ++sketch.size;
+    sketch.n += uint64_t{1} << level;
+  }
+  while (sketch.size >= sketch.max_size) {
+    sketch.compress();
+  }
+  return sketch;
+}
+
+npystream::Histogram::Histogram(double lower, double upper, size_t bins)
+    : lower{lower}, upper{upper}, scale{static_cast<double>(bins) / (upper - lower)},
+      bin_counts(bins + 2) {
+  if (!(upper > lower) || bins == 0) {
+    throw std::runtime_error{"Histogram: invalid binning"};
+  }
+}
+
+void npystream::Histogram::update(std::span<double const> values) {
+  std::array<uint32_t, 256> indices;
+  double const max_index = static_cast<double>(bin_counts.size() - 1);
+
+  while (!values.empty()) {
+    size_t const n = std::min(values.size(), indices.size());
+
+    // branch-free index computation, kept separate from the scattered increments so
+    // that it can be vectorized. Underflow (and NaN) lands in bin 0, overflow in the last.
+    for (size_t i = 0; i < n; ++i) {
+      double const pos = (values[i] - lower) * scale + 1.;
+      indices[i] = static_cast<uint32_t>(pos >= 0. ? std::min(pos, max_index) : 0.);
+    }
+    for (size_t i = 0; i < n; ++i) {
+      ++bin_counts[indices[i]];
+    }
+
+    values = values.subspan(n);
+  }
+}
+
+void npystream::Histogram::merge(Histogram const& other) {
+  if (lower != other.lower || upper != other.upper ||
+      bin_counts.size() != other.bin_counts.size()) {
+    throw std::runtime_error{"Histogram: cannot merge histograms with different binning"};
+  }
+  std::transform(bin_counts.cbegin(), bin_counts.cend(), other.bin_counts.cbegin(),
+                 bin_counts.begin(), std::plus<>{});
+}
+
+void npystream::Histogram::save(std::filesystem::path const& path) const {
+  NpyStream<double, uint64_t> stream{path, std::array{"lower_edge", "count"}};
+  size_t const bins = bin_counts.size() - 2;
+  stream << std::tuple{-std::numeric_limits<double>::infinity(), bin_counts.front()};
+  for (size_t i = 0; i < bins; ++i) {
+    stream << std::tuple{lower + static_cast<double>(i) * (upper - lower) / bins,
+                         bin_counts[i + 1]};
+  }
+  stream << std::tuple{upper, bin_counts.back()};
+  stream.close();
+}
+
+npystream::Histogram npystream::Histogram::load(std::filesystem::path const& path) {
+  NpyReader<double, uint64_t> const reader{path};
+  if (reader.size() < 3) {
+    throw std::runtime_error{"Histogram: invalid histogram file"};
+  }
+
+  Histogram histogram{reader.get<0>(1), reader.get<0>(reader.size() - 1), reader.size() - 2};
+  for (uint64_t i = 0; i < reader.size(); ++i) {
+    histogram.bin_counts[i] = reader.get<1>(i);
+  }
+  return histogram;
+}
@@ -0,0 +1,214 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <npystream/file_writer.hpp>
+#include <npystream/trace.hpp>
+
+namespace {
+/**
+ * Ring buffer slot, written only by its thread and read by stop() as a seqlock: seq is
+ * odd while the slot is being written and 2 * (i + 1) once it holds the i-th event of
+ * its thread. All fields are atomics, so that concurrent reads are not data races.
+ */
+struct Slot {
+  std::atomic<uint64_t> seq{};
+  std::atomic<char const*> name{};
+  std::atomic<uint64_t> begin{}, end{}, bytes{};
+};
+
+struct ThreadBuffer {
+  explicit ThreadBuffer(size_t capacity) : slots(capacity) {}
+
+  std::vector<Slot> slots;
+  std::atomic<uint64_t> recorded{}; //!< total number of events, the last ones are kept
+  uint64_t tid{};
+  bool retired{}; //!< the thread has exited, free the buffer with the next start()
+};
+
+struct Recorder {
+  std::mutex mutex;
+  std::filesystem::path path;
+  size_t capacity{};
+  uint64_t origin{};
+  std::vector<ThreadBuffer*> buffers; //!< buffers of the current recording
+  //! one buffer per thread, reused across recordings and freed after the thread exits
+  std::vector<std::unique_ptr<ThreadBuffer>> storage;
+  bool exit_hook{};
+};
+
+Recorder& recorder() {
+  static Recorder r;
+  return r;
+}
+
+std::atomic<bool> active{};
+std::atomic<uint64_t> session{}; //!< incremented by each start()
+
+void retire(ThreadBuffer* buffer);
+
+//! the buffer of a thread, which is released when the thread exits
+struct LocalBuffer {
+  ThreadBuffer* buffer{};
+  uint64_t session{};
+
+  ~LocalBuffer() {
+    if (buffer) {
+      retire(buffer);
+    }
+  }
+};
+
+thread_local LocalBuffer local;
+
+ThreadBuffer* register_thread(uint64_t current_session) {
+  Recorder& r = recorder();
+  std::lock_guard lock{r.mutex};
+  ThreadBuffer* buffer = local.buffer;
+  if (buffer == nullptr) {
+    buffer = r.storage.emplace_back(std::make_unique<ThreadBuffer>(r.capacity)).get();
+  } else if (buffer->slots.size() != r.capacity) {
+    buffer->slots = std::vector<Slot>(r.capacity);
+  } else {
+    for (Slot& slot : buffer->slots) {
+      slot.seq.store(0, std::memory_order_relaxed);
+    }
+  }
+  buffer->recorded.store(0, std::memory_order_relaxed);
+  buffer->tid = r.buffers.size();
+  r.buffers.push_back(buffer);
+  local.session = current_session;
+  return local.buffer = buffer;
+}
+
+void retire(ThreadBuffer* buffer) {
+  Recorder& r = recorder();
+  std::lock_guard lock{r.mutex};
+  if (std::ranges::find(r.buffers, buffer) != r.buffers.end()) {
+    buffer->retired = true; // its events are still to be written
+  } else {
+    std::erase_if(r.storage, [buffer](auto const& b) { return b.get() == buffer; });
+  }
+}
+
+void write_trace(Recorder& r) {
+  std::string json{"{\"traceEvents\":[\n"};
+  bool first = true;
+  for (ThreadBuffer const* buffer : r.buffers) {
+    uint64_t const recorded = buffer->recorded.load(std::memory_order_acquire);
+    uint64_t const capacity = buffer->slots.size();
+    for (uint64_t i = recorded - std::min(recorded, capacity); i < recorded; ++i) {
+      Slot const& slot = buffer->slots[i % capacity];
+      uint64_t const seq = slot.seq.load(std::memory_order_acquire);
+      char const* const name = slot.name.load(std::memory_order_relaxed);
+      uint64_t const begin = slot.begin.load(std::memory_order_relaxed);
+      uint64_t const end = slot.end.load(std::memory_order_relaxed);
+      uint64_t const bytes = slot.bytes.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq != 2 * (i + 1) || slot.seq.load(std::memory_order_relaxed) != seq) {
+        continue; // overwritten by the thread meanwhile
+      }
+
+      json += first ? "" : ",\n";
+      first = false;
+      // Chrome trace timestamps are in microseconds
+      double const ts = (std::max(begin, r.origin) - r.origin) / 1e3;
+      double const dur = (end - begin) / 1e3;
+      json += R"({"name":")";
+      json += name;
+      json += std::format(R"(","ph":"X","pid":1,"tid":{},"ts":{},"dur":{})", buffer->tid, ts, dur);
+      if (bytes) {
+        json += std::format(R"(,"args":{{"bytes":{}}})", bytes);
+      }
+      json += '}';
+    }
+  }
+  json += "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+  npystream::FileWriter file{r.path};
+  file.write(json.data(), json.size());
+  file.close();
+}
+
+void stop_at_exit() {
+  try {
+    npystream::trace::stop();
+  } catch (...) {
+    // nothing sensible left to do during exit
+  }
+}
+} // namespace
+
+void npystream::trace::start(std::filesystem::path const& path, size_t capacity_per_thread) {
+  Recorder& r = recorder();
+  std::lock_guard lock{r.mutex};
+  r.path = path;
+  r.capacity = std::max<size_t>(1, capacity_per_thread);
+  r.origin = detail::now();
+  r.buffers.clear();
+  std::erase_if(r.storage, [](auto const& b) { return b->retired; });
+  session.fetch_add(1, std::memory_order_relaxed);
+  if (!r.exit_hook) {
+    std::atexit(stop_at_exit);
+    r.exit_hook = true;
+  }
+  active.store(true, std::memory_order_release);
+}
+
+void npystream::trace::stop() {
+  Recorder& r = recorder();
+  std::lock_guard lock{r.mutex};
+  if (!active.exchange(false, std::memory_order_acq_rel)) {
+    return;
+  }
+  write_trace(r);
+}
+
+bool npystream::trace::enabled() noexcept {
+  return active.load(std::memory_order_relaxed);
+}
+
+uint64_t npystream::trace::detail::now() noexcept {
+  auto const t = std::chrono::steady_clock::now().time_since_epoch();
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t).count()) |
+         1;
+}
+
+void npystream::trace::detail::record(char const* name, uint64_t begin, uint64_t end,
+                                      uint64_t bytes) noexcept {
+  uint64_t const current_session = session.load(std::memory_order_acquire);
+  if (!active.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  ThreadBuffer* buffer = local.buffer;
+  if (local.session != current_session) {
+    try {
+      buffer = register_thread(current_session);
+    } catch (...) {
+      return; // out of memory, drop the event
+    }
+  }
+
+  uint64_t const i = buffer->recorded.load(std::memory_order_relaxed);
+  Slot& slot = buffer->slots[i % buffer->slots.size()];
+  slot.seq.store(2 * i + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.begin.store(begin, std::memory_order_relaxed);
+  slot.end.store(end, std::memory_order_relaxed);
+  slot.bytes.store(bytes, std::memory_order_relaxed);
+  slot.seq.store(2 * (i + 1), std::memory_order_release);
+  buffer->recorded.store(i + 1, std::memory_order_release);
+}
@@ -0,0 +1,84 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <npystream/record_observer.hpp>
+#include <npystream/zone_map.hpp>
+
+npystream::ZoneMap::ZoneMap(std::filesystem::path const& path)
+    : file{path}, header{parse_npy_header(file.bytes())} {
+  if (header.shape.size() != 1 || header.labels.empty() || header.labels[0] != "first_record" ||
+      header.sizes[0] != sizeof(uint64_t) || header.labels.size() % 2 != 1) {
+    throw std::runtime_error{"ZoneMap: " + path.string() + " is not a zone map"};
+  }
+
+  offsets.resize(header.sizes.size());
+  std::exclusive_scan(header.sizes.cbegin(), header.sizes.cend(), offsets.begin(), size_t{});
+  record_size = offsets.back() + header.sizes.back();
+
+  if ((file.bytes().size() - header.data_offset) / record_size < blocks()) {
+    throw std::runtime_error{"ZoneMap: file is truncated"};
+  }
+}
+
+std::optional<npystream::ZoneMap>
+npystream::ZoneMap::open_for(std::filesystem::path const& data_path, uint64_t records) {
+  auto const path = sidecar_path(data_path, ".zonemap.npy");
+  std::error_code ec;
+  auto const map_time = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return std::nullopt;
+  }
+  // the zone map is written after the data file has been closed
+  auto const data_time = std::filesystem::last_write_time(data_path, ec);
+  if (ec || map_time < data_time) {
+    return std::nullopt;
+  }
+
+  try {
+    ZoneMap zones{path};
+    if (zones.covers(records)) {
+      return zones;
+    }
+  } catch (std::exception const&) {
+    // a damaged zone map only costs the skipping of blocks, not the access to the data
+  }
+  return std::nullopt;
+}
+
+bool npystream::ZoneMap::covers(uint64_t records) const {
+  uint64_t const n = blocks();
+  if (n == 0 || records == 0) {
+    return n == 0 && records == 0;
+  }
+  uint64_t const block_records = (n > 1) ? first_record(1) : records;
+  if (block_records == 0 || (records - 1) / block_records + 1 != n) {
+    return false;
+  }
+  for (uint64_t b = 0; b < n; ++b) {
+    if (first_record(b) != b * block_records) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::optional<size_t> npystream::ZoneMap::column(std::string_view label) const {
+  for (size_t c = 1; c + 1 < header.labels.size(); c += 2) {
+    std::string_view const name = header.labels[c];
+    if (name.size() == label.size() + 4 && name.starts_with(label) && name.ends_with("_min")) {
+      return c;
+    }
+  }
+  return std::nullopt;
+}
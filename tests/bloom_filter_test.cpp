@@ -0,0 +1,82 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// Bloom filters: no false negatives, a bounded false positive rate, the sidecar written
+// by NpyStream::add_bloom_filter() and the lookup over several files.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include <npystream/bloom_filter.hpp>
+#include <npystream/npystream.hpp>
+
+#include "check.hpp"
+
+namespace {
+void write_file(std::filesystem::path const& path, uint64_t first_key, uint64_t count) {
+  npystream::NpyStream<uint64_t, float> stream{path, std::array{"key", "value"}};
+  stream.add_bloom_filter<0>(count);
+  for (uint64_t key = first_key; key < first_key + count; ++key) {
+    stream << std::tuple{key, 1.f};
+  }
+}
+} // namespace
+
+int main() {
+  npystream::test::ScratchDirectory const dir{"bloom_filter"};
+  uint64_t constexpr n = 50'000;
+
+  write_file(dir / "a.npy", 0, n);
+  write_file(dir / "b.npy", n, n);
+  auto const filter =
+      npystream::BloomFilter::load(npystream::bloom_filter_path(dir / "a.npy", "key"));
+
+  bool all_found = true;
+  for (uint64_t key = 0; key < n; ++key) {
+    all_found = all_found && filter.may_contain(key);
+  }
+  CHECK(all_found);
+
+  // about 1% at 10 bits per key
+  uint64_t false_positives = 0;
+  for (uint64_t key = 10 * n; key < 11 * n; ++key) {
+    false_positives += filter.may_contain(key);
+  }
+  CHECK(false_positives < n / 50);
+
+  // merged filters contain the keys of both
+  npystream::BloomFilter merged{n};
+  merged.insert(std::array<uint64_t, 2>{1, 2});
+  npystream::BloomFilter other{n};
+  other.insert(3);
+  merged.merge(other);
+  CHECK(merged.may_contain(1) && merged.may_contain(3));
+  CHECK_THROWS(std::runtime_error, merged.merge(npystream::BloomFilter{100 * n}));
+
+  // files without a filter are always candidates
+  {
+    npystream::NpyStream<uint64_t, float> c{dir / "c.npy", std::array{"key", "value"}};
+  }
+  std::vector<std::filesystem::path> const files{dir / "a.npy", dir / "b.npy", dir / "c.npy"};
+  npystream::BloomFilterSet const set{files, "key"};
+  auto const candidates = set.candidates(n + 17);
+  CHECK(std::ranges::find(candidates, dir / "b.npy") != candidates.end());
+  CHECK(std::ranges::find(candidates, dir / "c.npy") != candidates.end());
+  CHECK(candidates.size() <= 3);
+
+  // a file of the wrong size is no filter
+  {
+    npystream::NpyStream<uint64_t> odd{dir / "odd.bloom.npy"};
+    odd << uint64_t{1} << uint64_t{2} << uint64_t{3};
+  }
+  CHECK_THROWS(std::runtime_error, npystream::BloomFilter::load(dir / "odd.bloom.npy"));
+
+  return npystream::test::result();
+}
@@ -0,0 +1,89 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// Minimal checks for the tests, which are plain executables run by ctest: a failed
+// check is reported and the test continues, main() returns test::result().
+
+#pragma once
+
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace npystream::test {
+
+inline int failures = 0;
+
+inline void fail(char const* expression, char const* file, int line, std::string const& what = {}) {
+  std::cerr << file << ":" << line << ": check failed: " << expression;
+  if (!what.empty()) {
+    std::cerr << " (" << what << ")";
+  }
+  std::cerr << "\n";
+  ++failures;
+}
+
+//! exit code of the test
+inline int result() {
+  if (failures > 0) {
+    std::cerr << failures << " check(s) failed\n";
+  }
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//! empty directory in the temporary directory, removed with all contents on destruction
+class ScratchDirectory {
+public:
+  explicit ScratchDirectory(std::string const& name)
+      : path{std::filesystem::temp_directory_path() /
+             ("npystream-" + name + "-" + std::to_string(std::random_device{}()))} {
+    std::filesystem::remove_all(path);
+    std::filesystem::create_directories(path);
+  }
+
+  ScratchDirectory(ScratchDirectory const&) = delete;
+  ScratchDirectory& operator=(ScratchDirectory const&) = delete;
+
+  ~ScratchDirectory() {
+    std::error_code ec;
+    std::filesystem::remove_all(path, ec);
+  }
+
+  std::filesystem::path operator/(std::string const& name) const {
+    return path / name;
+  }
+
+  std::filesystem::path const path;
+};
+
+} // namespace npystream::test
+
+#define CHECK(...)                                                                                 \
+  do {                                                                                             \
+    try {                                                                                          \
+      if (!(__VA_ARGS__)) {                                                                        \
+        ::npystream::test::fail(#__VA_ARGS__, __FILE__, __LINE__);                                 \
+      }                                                                                            \
+    } catch (std::exception const& e) {                                                            \
+      ::npystream::test::fail(#__VA_ARGS__, __FILE__, __LINE__, e.what());                         \
+    }                                                                                              \
+  } while (false)
+
+#define CHECK_THROWS(Exception, ...)                                                               \
+  do {                                                                                             \
+    bool thrown_ = false;                                                                          \
+    try {                                                                                          \
+      __VA_ARGS__;                                                                                 \
+    } catch (Exception const&) {                                                                   \
+      thrown_ = true;                                                                              \
+    } catch (...) {                                                                                \
+    }                                                                                              \
+    if (!thrown_) {                                                                                \
+      ::npystream::test::fail(#__VA_ARGS__ " throws " #Exception, __FILE__, __LINE__);            \
+    }                                                                                              \
+  } while (false)
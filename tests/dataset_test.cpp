@@ -0,0 +1,90 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// NpyDataset over shards found in a directory or listed in a manifest: global indexing,
+// iteration, parallel visits, and rejection of shards that do not fit.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include <npystream/dataset.hpp>
+#include <npystream/npystream.hpp>
+
+#include "check.hpp"
+
+namespace {
+using Dataset = npystream::NpyDataset<int64_t, double>;
+
+void write_shard(std::filesystem::path const& path, int64_t first, int64_t count) {
+  npystream::NpyStream<int64_t, double> stream{path, std::array{"t", "x"}};
+  stream.add_zone_map(); // sidecars in the directory are not shards
+  for (int64_t t = first; t < first + count; ++t) {
+    stream << std::tuple{t, 0.5 * t};
+  }
+}
+} // namespace
+
+int main() {
+  npystream::test::ScratchDirectory const dir{"dataset"};
+  std::filesystem::create_directory(dir / "shards");
+  write_shard(dir / "shards/part-2.npy", 150, 0);
+  write_shard(dir / "shards/part-0.npy", 0, 100);
+  write_shard(dir / "shards/part-1.npy", 100, 50);
+  write_shard(dir / "shards/part-3.npy", 150, 25);
+
+  auto const dataset = Dataset::from_directory(dir / "shards", 2);
+  CHECK(dataset.shard_count() == 4);
+  CHECK(dataset.size() == 175);
+  CHECK(dataset.shard_path(1).filename() == "part-1.npy");
+  CHECK(dataset.first_record(3) == 150 && dataset.shard_of(150) == 3);
+  CHECK(dataset[0] == std::tuple{int64_t{0}, 0.});
+  CHECK(dataset.get<0>(99) == 99 && dataset.get<0>(100) == 100 && dataset.get<1>(174) == 87.);
+
+  bool in_order = true;
+  int64_t expected = 0;
+  for (auto const [t, x] : dataset) {
+    in_order = in_order && t == expected++ && x == 0.5 * t;
+  }
+  CHECK(in_order && expected == 175);
+
+  std::vector<std::atomic<int>> visits(dataset.size());
+  std::atomic<bool> consistent{true};
+  dataset.for_each(
+      [&](uint64_t i, std::tuple<int64_t, double> const& record) {
+        ++visits[i];
+        if (std::get<0>(record) != static_cast<int64_t>(i)) {
+          consistent = false;
+        }
+      },
+      3);
+  CHECK(consistent);
+  CHECK(std::ranges::all_of(visits, [](auto const& v) { return v == 1; }));
+
+  // manifests list shards relative to their own directory
+  {
+    std::ofstream manifest{dir / "manifest.txt"};
+    manifest << "shards/part-3.npy\n\nshards/part-0.npy\r\n";
+  }
+  auto const listed = Dataset::from_manifest(dir / "manifest.txt");
+  CHECK(listed.shard_count() == 2 && listed.size() == 125);
+  CHECK(listed.get<0>(0) == 150 && listed.get<0>(25) == 0);
+  CHECK_THROWS(std::runtime_error, Dataset::from_manifest(dir / "missing.txt"));
+
+  // shards of another record type
+  {
+    npystream::NpyStream<int32_t, double> other{dir / "other.npy"};
+  }
+  CHECK_THROWS(std::runtime_error,
+               Dataset(std::vector{dir / "shards/part-0.npy", dir / "other.npy"}));
+
+  return npystream::test::result();
+}
@@ -0,0 +1,108 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// Group commits of DurabilityManager from several threads, after which the files are
+// complete up to the synced records, and close_all with per-stream errors.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <npystream/close_all.hpp>
+#include <npystream/durability.hpp>
+#include <npystream/npyreader.hpp>
+#include <npystream/npystream.hpp>
+
+#include "check.hpp"
+
+#ifndef _WIN32
+#  include <csignal>
+#  include <sys/resource.h>
+#endif
+
+namespace {
+std::filesystem::path stream_path(npystream::test::ScratchDirectory const& dir, unsigned t) {
+  return dir / ("stream" + std::to_string(t) + ".npy");
+}
+
+void group_commit(npystream::test::ScratchDirectory const& dir,
+                  npystream::DurabilityManager::Method method) {
+  unsigned constexpr num_threads = 8;
+  npystream::DurabilityManager manager{std::chrono::microseconds{500}, method};
+  std::vector<npystream::NpyStream<uint64_t>> streams;
+  for (unsigned t = 0; t < num_threads; ++t) {
+    streams.emplace_back(stream_path(dir, t));
+  }
+
+  std::vector<int> synced(num_threads);
+  {
+    std::vector<std::jthread> threads;
+    for (unsigned t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&, t] {
+        for (uint64_t i = 0; i < 1000; ++i) {
+          streams[t] << i;
+          if (i % 100 == 99) {
+            manager.sync(streams[t]);
+            // the header covers everything written before the sync
+            synced[t] += npystream::NpyReader<uint64_t>{stream_path(dir, t)}.size() == i + 1;
+          }
+        }
+      });
+    }
+  }
+  CHECK(std::ranges::all_of(synced, [](int n) { return n == 10; }));
+
+  auto const errors = npystream::close_all(streams, 3);
+  CHECK(std::ranges::all_of(errors, [](auto const& e) { return !e; }));
+  CHECK(npystream::NpyReader<uint64_t>{stream_path(dir, 7)}.size() == 1000);
+}
+
+#ifndef _WIN32
+void close_all_errors(npystream::test::ScratchDirectory const& dir) {
+  std::vector<npystream::NpyStream<double>> streams;
+  for (unsigned t = 0; t < 6; ++t) {
+    streams.emplace_back(stream_path(dir, t));
+  }
+
+  // files may not grow beyond 16 KiB, which the odd streams exceed
+  std::signal(SIGXFSZ, SIG_IGN);
+  rlimit limit;
+  ::getrlimit(RLIMIT_FSIZE, &limit);
+  rlimit const restricted{16 << 10, limit.rlim_max};
+  CHECK(::setrlimit(RLIMIT_FSIZE, &restricted) == 0);
+  for (unsigned t = 0; t < streams.size(); ++t) {
+    for (int i = 0; i < ((t % 2) ? 4000 : 100); ++i) {
+      streams[t] << 1.;
+    }
+  }
+
+  auto const errors = npystream::close_all(streams, 4);
+  ::setrlimit(RLIMIT_FSIZE, &limit);
+
+  CHECK(errors.size() == streams.size());
+  for (unsigned t = 0; t < errors.size(); ++t) {
+    CHECK(static_cast<bool>(errors[t]) == (t % 2 == 1));
+  }
+  CHECK_THROWS(std::system_error, std::rethrow_exception(errors[1]));
+  CHECK(npystream::NpyReader<double>{stream_path(dir, 4)}.size() == 100);
+}
+#endif
+} // namespace
+
+int main() {
+  npystream::test::ScratchDirectory const dir{"durability"};
+  group_commit(dir, npystream::DurabilityManager::Method::DataSync);
+  group_commit(dir, npystream::DurabilityManager::Method::FileSystem);
+#ifndef _WIN32
+  close_all_errors(dir);
+#endif
+  return npystream::test::result();
+}
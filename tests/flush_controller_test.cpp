@@ -0,0 +1,68 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// FlushController with synthetic flush durations: additive increase while larger flushes
+// gain bandwidth, holding and probing on a plateau, multiplicative decrease on slow
+// flushes and recovery afterwards.
+
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+
+#include <npystream/flush_controller.hpp>
+
+#include "check.hpp"
+
+namespace {
+using namespace std::chrono_literals;
+
+//! flush of the current threshold with the given duration
+void flush(npystream::FlushController& controller, std::chrono::nanoseconds duration) {
+  controller.update(controller.threshold() * sizeof(double), duration);
+}
+} // namespace
+
+int main() {
+  npystream::AdaptiveFlush const policy{.min_bytes = 4096, .max_bytes = 1 << 16,
+                                        .target_latency = 1ms};
+  CHECK_THROWS(std::runtime_error,
+               npystream::FlushController({.min_bytes = 1 << 17, .max_bytes = 1 << 16}, 8));
+
+  npystream::FlushController controller{policy, sizeof(double)};
+  CHECK(controller.threshold() == 512 && controller.capacity() == 8192);
+
+  // fixed latency, so that larger flushes have a higher bandwidth: grows up to the maximum
+  for (int i = 0; i < 20; ++i) {
+    flush(controller, 10us);
+  }
+  CHECK(controller.threshold() == 8192);
+
+  // a slow flush halves the threshold
+  flush(controller, 2ms);
+  CHECK(controller.threshold() == 4096);
+  flush(controller, 2ms);
+  CHECK(controller.threshold() == 2048);
+
+  // bandwidth independent of the size: the threshold is held, but probed every 16 flushes
+  auto const constant_bandwidth = [&] {
+    flush(controller, std::chrono::nanoseconds{controller.threshold() * 10});
+  };
+  constant_bandwidth(); // first sample after the decrease, which grows the threshold
+  CHECK(controller.threshold() == 2560);
+  for (int i = 0; i < 15; ++i) {
+    constant_bandwidth();
+  }
+  CHECK(controller.threshold() == 2560);
+  constant_bandwidth();
+  CHECK(controller.threshold() == 3072);
+
+  // never below the minimum
+  for (int i = 0; i < 10; ++i) {
+    flush(controller, 1s);
+  }
+  CHECK(controller.threshold() == 512);
+
+  return npystream::test::result();
+}
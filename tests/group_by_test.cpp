@@ -0,0 +1,92 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// group_by against a straightforward aggregation with std::map, for several thread
+// counts, and the labels of its output.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <tuple>
+
+#include <npystream/group_by.hpp>
+#include <npystream/npyreader.hpp>
+#include <npystream/npystream.hpp>
+
+#include "check.hpp"
+
+namespace {
+struct Expected {
+  uint64_t count{};
+  double x_sum{};
+  float x_min{INFINITY}, x_max{-INFINITY};
+  int64_t y_sum{};
+  int16_t y_min{INT16_MAX}, y_max{INT16_MIN};
+};
+} // namespace
+
+int main() {
+  npystream::test::ScratchDirectory const dir{"group_by"};
+  auto const input = dir / "input.npy";
+  {
+    npystream::NpyStream<int32_t, float, int16_t> stream{input, std::array{"key", "x", "y"}};
+    for (int i = 0; i < 200'000; ++i) {
+      stream << std::tuple{(i * 7919) % 3001 - 1500, static_cast<float>(std::sin(i) * 100),
+                           static_cast<int16_t>((i * 31) % 2000 - 1000)};
+    }
+  }
+
+  npystream::NpyReader<int32_t, float, int16_t> const reader{input};
+  std::map<int32_t, Expected> expected;
+  for (uint64_t i = 0; i < reader.size(); ++i) {
+    auto const [key, x, y] = reader[i];
+    Expected& e = expected[key];
+    ++e.count;
+    e.x_sum += x;
+    e.x_min = std::min(e.x_min, x);
+    e.x_max = std::max(e.x_max, x);
+    e.y_sum += y;
+    e.y_min = std::min(e.y_min, y);
+    e.y_max = std::max(e.y_max, y);
+  }
+
+  for (unsigned const threads : {1u, 3u, 8u}) {
+    auto const output = dir / "grouped.npy";
+    npystream::group_by<0, 1, 2>(reader, output, threads);
+
+    npystream::NpyReader<int32_t, uint64_t, double, float, float, int64_t, int16_t, int16_t> const
+        grouped{output};
+    CHECK(grouped.size() == expected.size());
+    CHECK(std::ranges::equal(grouped.labels(),
+                             std::array{"key", "count", "x_sum", "x_min", "x_max", "y_sum",
+                                        "y_min", "y_max"}));
+
+    bool equal = grouped.size() == expected.size();
+    uint64_t i = 0;
+    for (auto const& [key, e] : expected) {
+      if (!equal) {
+        break;
+      }
+      auto const [k, count, x_sum, x_min, x_max, y_sum, y_min, y_max] = grouped[i++];
+      equal = k == key && count == e.count && std::abs(x_sum - e.x_sum) < 1e-6 &&
+              x_min == e.x_min && x_max == e.x_max && y_sum == e.y_sum && y_min == e.y_min &&
+              y_max == e.y_max;
+    }
+    CHECK(equal);
+  }
+
+  // no records, no groups
+  auto const empty = dir / "empty.npy";
+  {
+    npystream::NpyStream<int64_t, double> stream{empty};
+  }
+  npystream::group_by<0, 1>(npystream::NpyReader<int64_t, double>{empty}, dir / "none.npy");
+  CHECK((npystream::NpyReader<int64_t, uint64_t, double, double, double>{dir / "none.npy"}
+             .size() == 0));
+
+  return npystream::test::result();
+}
@@ -0,0 +1,79 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// Inner, left and as-of merge joins of small hand-checked inputs, including keys that
+// occur several times on both sides.
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <tuple>
+#include <vector>
+
+#include <npystream/merge_join.hpp>
+#include <npystream/npyreader.hpp>
+#include <npystream/npystream.hpp>
+
+#include "check.hpp"
+
+namespace {
+using npystream::fields;
+using npystream::JoinKind;
+using Joined = npystream::NpyReader<int, int64_t, int, double>;
+using Records = std::vector<std::tuple<int, int64_t, int, double>>;
+
+template <typename... Ts>
+void write_file(std::filesystem::path const& path, std::vector<std::tuple<Ts...>> const& records) {
+  npystream::NpyStream<Ts...> stream{path, std::array{"symbol", "time", "value"}};
+  for (auto const& r : records) {
+    stream << r;
+  }
+}
+
+Records read_all(std::filesystem::path const& path) {
+  Joined const reader{path};
+  Records records;
+  for (uint64_t i = 0; i < reader.size(); ++i) {
+    records.push_back(reader[i]);
+  }
+  return records;
+}
+} // namespace
+
+int main() {
+  npystream::test::ScratchDirectory const dir{"merge_join"};
+  auto const trades_path = dir / "trades.npy", quotes_path = dir / "quotes.npy";
+  write_file<int, int64_t, int>(trades_path,
+                                {{1, 10, 100}, {1, 20, 200}, {2, 5, 50}, {3, 7, 70}});
+  write_file<int, int64_t, double>(
+      quotes_path, {{1, 9, 1.}, {1, 15, 1.5}, {1, 20, 2.}, {2, 6, 2.6}, {4, 1, 4.}});
+  npystream::NpyReader<int, int64_t, int> const trades{trades_path};
+  npystream::NpyReader<int, int64_t, double> const quotes{quotes_path};
+  auto const output = dir / "joined.npy";
+
+  CHECK(npystream::merge_join(trades, quotes, output, JoinKind::Inner, fields<0, 1>{},
+                              fields<0, 1>{}, fields<0, 1, 2>{}, fields<2>{}) == 1);
+  CHECK((read_all(output) == Records{{1, 20, 200, 2.}}));
+
+  CHECK(npystream::merge_join(trades, quotes, output, JoinKind::Left, fields<0, 1>{},
+                              fields<0, 1>{}, fields<0, 1, 2>{}, fields<2>{}) == 4);
+  CHECK((read_all(output) ==
+         Records{{1, 10, 100, 0.}, {1, 20, 200, 2.}, {2, 5, 50, 0.}, {3, 7, 70, 0.}}));
+
+  CHECK(npystream::merge_join(trades, quotes, output, JoinKind::AsOf, fields<0, 1>{},
+                              fields<0, 1>{}, fields<0, 1, 2>{}, fields<2>{}) == 4);
+  CHECK((read_all(output) ==
+         Records{{1, 10, 100, 1.}, {1, 20, 200, 2.}, {2, 5, 50, 0.}, {3, 7, 70, 0.}}));
+  CHECK(Joined{output}.labels()[3] == "value_right");
+
+  // on the symbol only, every pair of equal keys is emitted
+  CHECK(npystream::merge_join(trades, quotes, output, JoinKind::Inner, fields<0>{}, fields<0>{},
+                              fields<0, 1, 2>{}, fields<2>{}) == 7);
+  auto const pairs = read_all(output);
+  CHECK(pairs.size() == 7 && pairs[5] == std::tuple{1, int64_t{20}, 200, 2.} &&
+        pairs[6] == std::tuple{2, int64_t{5}, 50, 2.6});
+
+  return npystream::test::result();
+}
@@ -0,0 +1,91 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// MultiplexedLog with more streams than open files: the stream files are complete after
+// compact() and close(), hold every record exactly once and in order, and compaction
+// errors are reported by close().
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <vector>
+
+#include <npystream/multiplexed_log.hpp>
+#include <npystream/npyreader.hpp>
+
+#include "check.hpp"
+
+namespace {
+using Reader = npystream::NpyReader<uint32_t, double>;
+
+std::filesystem::path stream_path(npystream::test::ScratchDirectory const& dir, int s) {
+  return dir / ("stream" + std::to_string(s) + ".npy");
+}
+
+//! whether stream s holds the records 0 ... count-1
+bool complete(npystream::test::ScratchDirectory const& dir, int s, uint32_t count) {
+  Reader const reader{stream_path(dir, s)};
+  bool equal = reader.size() == count && reader.labels()[1] == "x";
+  for (uint32_t i = 0; equal && i < count; ++i) {
+    equal = reader[i] == std::tuple{i, s + 0.5 * i};
+  }
+  return equal;
+}
+} // namespace
+
+int main() {
+  npystream::test::ScratchDirectory const dir{"multiplexed_log"};
+  int constexpr num_streams = 20;
+  auto const log_path = dir / "log.bin";
+
+  {
+    // small buffer, frequent compaction and only 4 open files for 20 streams
+    npystream::MultiplexedLog log{log_path, std::chrono::milliseconds{5}, 4096, 4};
+    std::vector<npystream::LogStream<uint32_t, double>> streams;
+    for (int s = 0; s < num_streams; ++s) {
+      streams.push_back(log.open<uint32_t, double>(stream_path(dir, s), std::array{"i", "x"}));
+    }
+    auto scalar = log.open<int64_t>(dir / "scalar.npy");
+
+    for (uint32_t i = 0; i < 2000; ++i) {
+      for (int s = 0; s < num_streams; ++s) {
+        streams[s] << std::tuple{i, s + 0.5 * i};
+      }
+      scalar << int64_t{i};
+      if (i == 999) {
+        log.compact();
+        bool all_complete = true;
+        for (int s = 0; s < num_streams; ++s) {
+          all_complete = all_complete && complete(dir, s, 1000);
+        }
+        CHECK(all_complete);
+      }
+    }
+    log.close();
+  }
+
+  CHECK(!std::filesystem::exists(log_path));
+  bool all_complete = true;
+  for (int s = 0; s < num_streams; ++s) {
+    all_complete = all_complete && complete(dir, s, 2000);
+  }
+  CHECK(all_complete);
+  npystream::NpyReader<int64_t> const scalar{dir / "scalar.npy"};
+  CHECK(scalar.size() == 2000 && scalar[1999] == 1999);
+
+  // stream files that cannot be created fail the compaction in close()
+  {
+    npystream::MultiplexedLog log{dir / "failing.bin", std::chrono::hours{1}};
+    auto stream = log.open<double>(dir / "missing" / "stream.npy");
+    stream << 1.;
+    CHECK_THROWS(std::system_error, log.close());
+  }
+
+  return npystream::test::result();
+}
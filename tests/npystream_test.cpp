@@ -0,0 +1,256 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// Round trips of NpyStream through NpyReader: scalar and structured records, bulk,
+// strided and split writes, checkpoints, moved streams, adaptive flush sizes, as well
+// as non-seekable descriptors and write errors reported by close().
+
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <list>
+#include <span>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <npystream/npy_header.hpp>
+#include <npystream/npyreader.hpp>
+#include <npystream/npystream.hpp>
+
+#include "check.hpp"
+
+#ifndef _WIN32
+#  include <csignal>
+#  include <sys/resource.h>
+#  include <unistd.h>
+#endif
+
+namespace {
+using npystream::NpyReader;
+using npystream::NpyStream;
+
+void scalar_round_trip(npystream::test::ScratchDirectory const& dir) {
+  auto const path = dir / "scalar.npy";
+  std::vector<double> values(200'000);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = 0.5 * static_cast<double>(i);
+  }
+
+  {
+    // single records and bulk writes interleaved, crossing the staging buffer
+    NpyStream<double> stream{path};
+    for (size_t i = 0; i < 1000; ++i) {
+      stream << values[i];
+    }
+    stream.write(std::span<double const>{values}.subspan(1000, 100'000));
+    std::list<double> const rest(values.begin() + 101'000, values.end());
+    stream.write(rest.begin(), rest.end());
+    stream.close();
+  }
+
+  NpyReader<double> const reader{path};
+  CHECK(reader.size() == values.size());
+  CHECK(reader.labels().empty());
+  bool equal = true;
+  for (uint64_t i = 0; i < reader.size(); ++i) {
+    equal = equal && reader[i] == values[i];
+  }
+  CHECK(equal);
+}
+
+void structured_round_trip(npystream::test::ScratchDirectory const& dir) {
+  auto const path = dir / "structured.npy";
+  std::vector<std::tuple<int16_t, double, uint8_t>> records;
+  for (int i = 0; i < 50'000; ++i) {
+    records.emplace_back(static_cast<int16_t>(i - 25'000), 1.5 * i, static_cast<uint8_t>(i));
+  }
+
+  {
+    NpyStream<int16_t, double, uint8_t> stream{path, std::array{"a", "b", "c"}};
+    stream << std::tuple{int16_t{-1}, 0., uint8_t{0}} << std::tuple{int16_t{7}, 2.5, uint8_t{3}};
+    // repacked from the padded tuple layout
+    stream.write(std::span<std::tuple<int16_t, double, uint8_t> const>{records});
+  }
+
+  NpyReader<int16_t, double, uint8_t> const reader{path};
+  CHECK(reader.size() == records.size() + 2);
+  CHECK(reader.labels().size() == 3 && reader.labels()[1] == "b");
+  CHECK(reader[1] == std::tuple{int16_t{7}, 2.5, uint8_t{3}});
+  bool equal = true;
+  for (size_t i = 0; i < records.size(); ++i) {
+    equal = equal && reader[i + 2] == records[i];
+  }
+  CHECK(equal);
+}
+
+void strided_and_split_writes(npystream::test::ScratchDirectory const& dir) {
+  size_t constexpr rows = 10'000, columns = 7;
+  std::vector<int32_t> matrix(rows * columns);
+  for (size_t i = 0; i < matrix.size(); ++i) {
+    matrix[i] = static_cast<int32_t>(i);
+  }
+  std::vector<float> re(rows), im(rows);
+  for (size_t i = 0; i < rows; ++i) {
+    re[i] = static_cast<float>(i);
+    im[i] = -static_cast<float>(i);
+  }
+
+  {
+    NpyStream<int32_t> column{dir / "column.npy"};
+    column << -1;
+    column.write_strided(matrix.data() + 3, rows, columns);
+    // backwards through the last column
+    column.write_strided(matrix.data() + matrix.size() - 1, rows,
+                         -static_cast<std::ptrdiff_t>(columns));
+
+    NpyStream<std::complex<float>> iq{dir / "iq.npy"};
+    iq.write_split(re, im);
+    CHECK_THROWS(std::runtime_error,
+                 iq.write_split(std::span<float const>{re}, std::span<float const>{im}.first(3)));
+  }
+
+  NpyReader<int32_t> const column{dir / "column.npy"};
+  CHECK(column.size() == 2 * rows + 1);
+  bool equal = column[0] == -1;
+  for (size_t r = 0; r < rows; ++r) {
+    equal = equal && column[1 + r] == matrix[r * columns + 3];
+    equal = equal && column[1 + rows + r] == matrix[(rows - 1 - r) * columns + columns - 1];
+  }
+  CHECK(equal);
+
+  NpyReader<std::complex<float>> const iq{dir / "iq.npy"};
+  CHECK(iq.size() == rows);
+  equal = true;
+  for (size_t i = 0; i < rows; ++i) {
+    equal = equal && iq[i] == std::complex{re[i], im[i]};
+  }
+  CHECK(equal);
+}
+
+void checkpoints_and_moves(npystream::test::ScratchDirectory const& dir) {
+  auto const path = dir / "checkpoint.npy";
+  NpyStream<uint32_t> stream{path};
+  for (uint32_t i = 0; i < 100; ++i) {
+    stream << i;
+  }
+  stream.checkpoint();
+  CHECK(NpyReader<uint32_t>{path}.size() == 100);
+
+  // streams stay usable when the vector holding them reallocates
+  std::vector<NpyStream<uint32_t>> streams;
+  streams.push_back(std::move(stream));
+  for (int s = 0; s < 8; ++s) {
+    streams.emplace_back(dir / ("moved" + std::to_string(s) + ".npy"));
+  }
+  for (uint32_t i = 0; i < 100; ++i) {
+    for (auto& s : streams) {
+      s << i;
+    }
+  }
+  streams.clear();
+
+  NpyReader<uint32_t> const reader{path};
+  CHECK(reader.size() == 200);
+  CHECK(reader[150] == 50);
+  CHECK(NpyReader<uint32_t>{dir / "moved7.npy"}.size() == 100);
+}
+
+void adaptive_flush_size(npystream::test::ScratchDirectory const& dir) {
+  auto const path = dir / "adaptive.npy";
+  {
+    NpyStream<uint64_t> stream{path};
+    stream << uint64_t{0};
+    stream.adapt_flush_size({.min_bytes = 4096, .max_bytes = 1 << 16});
+    CHECK(stream.flush_threshold() == 4096);
+    for (uint64_t i = 1; i < 100'000; ++i) {
+      stream << i;
+    }
+    CHECK(stream.flush_threshold() >= 4096 && stream.flush_threshold() <= (1 << 16));
+  }
+
+  NpyReader<uint64_t> const reader{path};
+  CHECK(reader.size() == 100'000);
+  bool equal = true;
+  for (uint64_t i = 0; i < reader.size(); ++i) {
+    equal = equal && reader[i] == i;
+  }
+  CHECK(equal);
+}
+
+#ifndef _WIN32
+void non_seekable_descriptor() {
+  int fds[2];
+  CHECK(::pipe(fds) == 0);
+
+  {
+    // small enough for the pipe buffer, so that nothing has to read concurrently
+    NpyStream<int32_t> stream{fds[1]};
+    for (int32_t i = 0; i < 1000; ++i) {
+      stream << i;
+    }
+    stream.close();
+  }
+
+  std::vector<unsigned char> bytes;
+  std::array<unsigned char, 4096> chunk;
+  for (ssize_t n; (n = ::read(fds[0], chunk.data(), chunk.size())) > 0;) {
+    bytes.insert(bytes.end(), chunk.begin(), chunk.begin() + n);
+  }
+  ::close(fds[0]);
+
+  // the header cannot be completed; it keeps the placeholder shape
+  auto const header = npystream::parse_npy_header(bytes);
+  CHECK(header.shape.size() == 1 && header.shape[0] == std::numeric_limits<uint64_t>::max());
+  CHECK(bytes.size() == header.data_offset + 1000 * sizeof(int32_t));
+  bool equal = true;
+  for (int32_t i = 0; i < 1000; ++i) {
+    int32_t value;
+    std::memcpy(&value, bytes.data() + header.data_offset + i * sizeof(int32_t), sizeof(value));
+    equal = equal && value == i;
+  }
+  CHECK(equal);
+}
+
+void errors_surface_in_close(npystream::test::ScratchDirectory const& dir) {
+  // files may not grow beyond 16 KiB: the header is written, but staged records are not
+  std::signal(SIGXFSZ, SIG_IGN);
+  rlimit limit;
+  ::getrlimit(RLIMIT_FSIZE, &limit);
+  rlimit const restricted{16 << 10, limit.rlim_max};
+  CHECK(::setrlimit(RLIMIT_FSIZE, &restricted) == 0);
+
+  NpyStream<double> stream{dir / "limited.npy"};
+  for (int i = 0; i < 4000; ++i) {
+    stream << 1.;
+  }
+  CHECK_THROWS(std::system_error, stream.close());
+  stream.close(); // already closed, nothing left to report
+
+  NpyStream<double> bulk{dir / "limited-bulk.npy"};
+  std::vector<double> const values(100'000);
+  CHECK_THROWS(std::system_error, bulk.write(std::span{values}));
+
+  ::setrlimit(RLIMIT_FSIZE, &limit);
+}
+#endif
+} // namespace
+
+int main() {
+  npystream::test::ScratchDirectory const dir{"npystream"};
+  scalar_round_trip(dir);
+  structured_round_trip(dir);
+  strided_and_split_writes(dir);
+  checkpoints_and_moves(dir);
+  adaptive_flush_size(dir);
+#ifndef _WIN32
+  non_seekable_descriptor();
+  errors_surface_in_close(dir);
+#endif
+  return npystream::test::result();
+}
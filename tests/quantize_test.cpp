@@ -0,0 +1,145 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// Round trips of quantized streams with per-block and fixed scales: quantization error,
+// NaN, saturated infinities and out-of-range values, and companion files that do not
+// describe the data.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <npystream/npystream.hpp>
+#include <npystream/quantize.hpp>
+
+#include "check.hpp"
+
+namespace {
+float const inf = std::numeric_limits<float>::infinity();
+float const nan = std::numeric_limits<float>::quiet_NaN();
+
+//! values of a wave, with NaN and infinities in the second block of 256
+std::vector<float> test_values() {
+  std::vector<float> values(1000);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = 100 * std::sin(0.01f * static_cast<float>(i));
+  }
+  values[300] = nan;
+  values[301] = inf;
+  values[302] = -inf;
+  return values;
+}
+
+template <typename Q>
+void block_round_trip(std::filesystem::path const& path) {
+  auto const values = test_values();
+  {
+    npystream::QuantizingNpyStream<Q> stream{path, {.block_size = 256}};
+    stream << values[0];
+    stream.write(std::span{values}.subspan(1, 600));
+    stream.write(std::span{values}.subspan(601));
+    CHECK(stream.blocks().size() == 3); // the last, partial block is written on close
+  }
+
+  npystream::DequantizingNpyReader<Q> const reader{path};
+  CHECK(reader.size() == values.size());
+  std::vector<float> restored(values.size());
+  reader.read(0, restored);
+
+  // minimum and maximum of the finite values of the block of value i
+  auto const block_range = [&](size_t i) {
+    float lo = inf, hi = -inf;
+    for (size_t j = i / 256 * 256; j < std::min(i / 256 * 256 + 256, values.size()); ++j) {
+      if (std::isfinite(values[j])) {
+        lo = std::min(lo, values[j]);
+        hi = std::max(hi, values[j]);
+      }
+    }
+    return std::pair{lo, hi};
+  };
+  // half a quantization step of the block
+  auto const tolerance = [&](size_t i) {
+    auto const [lo, hi] = block_range(i);
+    return 0.51f * (hi - lo) / (2.f * std::numeric_limits<Q>::max()) + 1e-4f;
+  };
+
+  bool accurate = true, consistent = true;
+  for (size_t i = 0; i < values.size(); ++i) {
+    consistent = consistent && (restored[i] == reader[i] || std::isnan(restored[i]));
+    if (std::isfinite(values[i])) {
+      accurate = accurate && std::abs(restored[i] - values[i]) <= tolerance(i);
+    }
+  }
+  CHECK(accurate);
+  CHECK(consistent);
+
+  // NaN is kept, infinities saturate to the ends of the block
+  CHECK(std::isnan(restored[300]));
+  CHECK(std::abs(restored[301] - block_range(301).second) <= tolerance(301));
+  CHECK(std::abs(restored[302] - block_range(302).first) <= tolerance(302));
+  CHECK_THROWS(std::out_of_range, reader.read(990, std::span{restored}.first(11)));
+}
+
+void fixed_scale(std::filesystem::path const& path) {
+  CHECK_THROWS(std::runtime_error, npystream::QuantizingNpyStream<int8_t>(path, {.scale = 0}));
+  {
+    npystream::QuantizingNpyStream<int8_t> stream{path, {.scale = 0.5f, .offset = 10}};
+    stream.write(std::array{10.f, 12.5f, 1000.f, -1000.f, nan, inf});
+  }
+  npystream::DequantizingNpyReader<int8_t> const reader{path};
+  CHECK(reader.size() == 6);
+  CHECK(reader[0] == 10.f && reader[1] == 12.5f);
+  CHECK(reader[2] == 10 + 0.5f * 127 && reader[3] == 10 - 0.5f * 127);
+  CHECK(std::isnan(reader[4]) && reader[5] == reader[2]);
+}
+
+void invalid_companion(npystream::test::ScratchDirectory const& dir) {
+  auto const path = dir / "broken.npy";
+  {
+    npystream::NpyStream<int16_t> data{path};
+    for (int16_t i = 0; i < 100; ++i) {
+      data << i;
+    }
+  }
+  CHECK_THROWS(std::runtime_error, npystream::DequantizingNpyReader<int16_t>{path});
+
+  auto const write_blocks = [&](std::vector<std::tuple<uint64_t, float, float>> const& blocks) {
+    npystream::NpyStream<uint64_t, float, float> companion{
+        npystream::detail::quantization_path(path), std::array{"first_record", "scale", "offset"}};
+    for (auto const& b : blocks) {
+      companion << b;
+    }
+  };
+
+  write_blocks({{0, 1.f, 0.f}, {50, 2.f, 0.f}});
+  CHECK(npystream::DequantizingNpyReader<int16_t>{path}[60] == 120.f);
+  // the data have to be of the quantized type
+  CHECK_THROWS(std::runtime_error, npystream::DequantizingNpyReader<int8_t>{path});
+  // not starting at 0, not increasing, beyond the end of the data
+  write_blocks({{10, 1.f, 0.f}});
+  CHECK_THROWS(std::runtime_error, npystream::DequantizingNpyReader<int16_t>{path});
+  write_blocks({{0, 1.f, 0.f}, {50, 1.f, 0.f}, {50, 1.f, 0.f}});
+  CHECK_THROWS(std::runtime_error, npystream::DequantizingNpyReader<int16_t>{path});
+  write_blocks({{0, 1.f, 0.f}, {100, 1.f, 0.f}});
+  CHECK_THROWS(std::runtime_error, npystream::DequantizingNpyReader<int16_t>{path});
+}
+} // namespace
+
+int main() {
+  npystream::test::ScratchDirectory const dir{"quantize"};
+  block_round_trip<int16_t>(dir / "int16.npy");
+  block_round_trip<int8_t>(dir / "int8.npy");
+  fixed_scale(dir / "fixed.npy");
+  invalid_companion(dir);
+  return npystream::test::result();
+}
@@ -0,0 +1,59 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// Round trips of NamedNpyStream and NamedNpyReader, and rejection of files whose labels
+// differ from the schema.
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+
+#include <npystream/schema.hpp>
+
+#include "check.hpp"
+
+namespace {
+using namespace npystream;
+using Trades = NamedNpyStream<field<"ts", int64_t>, field<"px", double>, field<"qty", int32_t>>;
+using TradesReader =
+    NamedNpyReader<field<"ts", int64_t>, field<"px", double>, field<"qty", int32_t>>;
+
+static_assert(Trades::schema::index_of<"px"> == 1);
+static_assert(std::is_same_v<Trades::schema::type_of<"qty">, int32_t>);
+} // namespace
+
+int main() {
+  test::ScratchDirectory const dir{"schema"};
+
+  {
+    Trades trades{dir / "trades.npy"};
+    trades.add_zone_map<"ts">(16);
+    trades << std::tuple{int64_t{1}, 100.5, 10};
+    for (int i = 2; i <= 100; ++i) {
+      // fields not set are zero
+      trades << Trades::record_type{}.set<"ts">(i).set<"px">(100. + i);
+    }
+  }
+
+  TradesReader const reader{dir / "trades.npy"};
+  CHECK(reader.size() == 100);
+  CHECK(reader.get<"ts">(0) == 1 && reader.get<"px">(0) == 100.5 && reader.get<"qty">(0) == 10);
+  CHECK(reader.get<"ts">(99) == 100 && reader.get<"qty">(99) == 0);
+  CHECK(reader.zone_map().has_value());
+
+  int found = 0;
+  reader.scan<"ts">(40, 49, [&](uint64_t i) { found += reader.get<"ts">(i) >= 40; });
+  CHECK(found == 10);
+
+  // same types, different labels
+  {
+    NpyStream<int64_t, double, int32_t> other{dir / "other.npy", std::array{"ts", "px", "q"}};
+  }
+  CHECK_THROWS(std::runtime_error, TradesReader{dir / "other.npy"});
+
+  return test::result();
+}
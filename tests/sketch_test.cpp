@@ -0,0 +1,90 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// Quantile sketches and histograms: accuracy, merging, and the sidecar files written by
+// NpyStream::add_sketch() and read back with load().
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include <npystream/npystream.hpp>
+#include <npystream/record_observer.hpp>
+#include <npystream/sketch.hpp>
+
+#include "check.hpp"
+
+namespace {
+//! values i / n for i = 0 ... n-1 in a scrambled order
+std::vector<double> uniform_values(uint64_t n) {
+  std::vector<double> values(n);
+  for (uint64_t i = 0; i < n; ++i) {
+    values[i] = static_cast<double>((i * 7919) % n) / static_cast<double>(n);
+  }
+  return values;
+}
+
+bool near(double a, double b, double tolerance) {
+  return std::abs(a - b) <= tolerance;
+}
+} // namespace
+
+int main() {
+  npystream::test::ScratchDirectory const dir{"sketch"};
+  uint64_t constexpr n = 100'000;
+  auto const values = uniform_values(n);
+
+  // rank error of about 1.7 / k
+  npystream::KllSketch first, second;
+  first.update(std::span{values}.first(n / 2));
+  second.update(std::span{values}.subspan(n / 2));
+  first.merge(second);
+  CHECK(first.count() == n);
+  for (double const q : {0.01, 0.25, 0.5, 0.9, 0.99}) {
+    CHECK(near(first.quantile(q), q, 0.02));
+  }
+  CHECK(std::isnan(npystream::KllSketch{}.quantile(0.5)));
+
+  first.save(dir / "kll.npy");
+  auto const loaded = npystream::KllSketch::load(dir / "kll.npy");
+  CHECK(loaded.count() == n);
+  CHECK(loaded.quantile(0.5) == first.quantile(0.5));
+
+  npystream::Histogram histogram{0., 1., 10};
+  histogram.update(std::array{-1., 0., 0.05, 0.999, 1., std::nan("")});
+  CHECK(histogram.counts()[0] == 2); // underflow and NaN
+  CHECK(histogram.counts()[1] == 2 && histogram.counts()[10] == 1 && histogram.counts()[11] == 1);
+  CHECK_THROWS(std::runtime_error, npystream::Histogram(1., 0., 10));
+  CHECK_THROWS(std::runtime_error, histogram.merge(npystream::Histogram{0., 1., 5}));
+
+  // sidecars of a stream
+  auto const path = dir / "data.npy";
+  {
+    npystream::NpyStream<uint32_t, double> stream{path, std::array{"id", "x"}};
+    stream.add_sketch<1>({.kll_k = 200, .histogram = {{0., 1., 10}}});
+    for (uint64_t i = 0; i < n; ++i) {
+      stream << std::tuple{static_cast<uint32_t>(i), values[i]};
+    }
+  }
+
+  auto const quantiles =
+      npystream::KllSketch::load(npystream::sidecar_path(path, ".x.quantiles.npy"));
+  CHECK(quantiles.count() == n);
+  CHECK(near(quantiles.quantile(0.5), 0.5, 0.02));
+
+  auto const bins = npystream::Histogram::load(npystream::sidecar_path(path, ".x.histogram.npy"));
+  auto const counts = bins.counts();
+  CHECK(counts.size() == 12);
+  CHECK(std::accumulate(counts.begin(), counts.end(), uint64_t{}) == n);
+  CHECK(counts[0] == 0 && counts[11] == 0);
+  CHECK(counts[5] == n / 10);
+
+  return npystream::test::result();
+}
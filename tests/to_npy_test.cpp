@@ -0,0 +1,59 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// Round trips of the range sink to_npy for sized, contiguous and unsized ranges.
+
+#include <array>
+#include <cstdint>
+#include <ranges>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <npystream/npyreader.hpp>
+#include <npystream/to_npy.hpp>
+
+#include "check.hpp"
+
+int main() {
+  npystream::test::ScratchDirectory const dir{"to_npy"};
+
+  // contiguous: written in bulk behind the final header
+  std::vector<int64_t> values(100'000);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<int64_t>(i * i);
+  }
+  CHECK((values | npystream::to_npy(dir / "contiguous.npy")) == values.size());
+  npystream::NpyReader<int64_t> const contiguous{dir / "contiguous.npy"};
+  CHECK(contiguous.size() == values.size());
+  CHECK(contiguous[99'999] == values[99'999]);
+
+  // sized, but not contiguous: structured records with labels
+  auto const pairs = std::views::iota(0, 70'000) |
+                     std::views::transform([](int i) { return std::pair{i, 0.5 * i}; });
+  CHECK((pairs | npystream::to_npy(dir / "pairs.npy", std::array{"i", "x"})) == 70'000);
+  npystream::NpyReader<int, double> const sized{dir / "pairs.npy"};
+  CHECK(sized.size() == 70'000);
+  CHECK(sized.labels()[0] == "i" && sized.labels()[1] == "x");
+  bool equal = true;
+  for (int i = 0; i < 70'000; ++i) {
+    equal = equal && sized[i] == std::tuple{i, 0.5 * i};
+  }
+  CHECK(equal);
+
+  // unsized: written through a stream
+  auto odd =
+      std::views::iota(0u, 10'001u) | std::views::filter([](unsigned i) { return i % 2 == 1; });
+  CHECK((odd | npystream::to_npy(dir / "odd.npy")) == 5000);
+  npystream::NpyReader<unsigned> const unsized{dir / "odd.npy"};
+  CHECK(unsized.size() == 5000);
+  CHECK(unsized[0] == 1 && unsized[4999] == 9999);
+
+  // empty ranges give valid, empty files
+  CHECK((std::vector<float>{} | npystream::to_npy(dir / "empty.npy")) == 0);
+  CHECK(npystream::NpyReader<float>{dir / "empty.npy"}.size() == 0);
+
+  return npystream::test::result();
+}
@@ -0,0 +1,47 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// I/O timeline of a stream recorded with trace::start() and written by trace::stop().
+
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <npystream/npystream.hpp>
+#include <npystream/trace.hpp>
+
+#include "check.hpp"
+
+int main() {
+  npystream::test::ScratchDirectory const dir{"trace"};
+  auto const trace_path = dir / "trace.json";
+
+  CHECK(!npystream::trace::enabled());
+  npystream::trace::start(trace_path);
+  CHECK(npystream::trace::enabled());
+  {
+    npystream::NpyStream<double> stream{dir / "data.npy"};
+    std::vector<double> const values(10'000, 1.);
+    stream.write(std::span{values});
+    for (int i = 0; i < 20'000; ++i) {
+      stream << 2.;
+    }
+  }
+  npystream::trace::stop();
+  CHECK(!npystream::trace::enabled());
+
+  std::ifstream in{trace_path};
+  std::string const json{std::istreambuf_iterator<char>{in}, {}};
+  CHECK(json.starts_with("{\"traceEvents\":["));
+  CHECK(json.ends_with("],\"displayTimeUnit\":\"ns\"}\n"));
+  CHECK(json.find(R"({"name":"write","ph":"X")") != std::string::npos);
+  CHECK(json.find(R"("args":{"bytes":80000}})") != std::string::npos);
+  CHECK(json.find(R"({"name":"flush")") != std::string::npos);
+  CHECK(json.find(R"({"name":"wrap_up")") != std::string::npos);
+
+  return npystream::test::result();
+}
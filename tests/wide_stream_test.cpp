@@ -0,0 +1,67 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// Round trips of WideNpyStream: rows written singly and in batches are read back
+// through the header and the raw records.
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include <npystream/mapped_file.hpp>
+#include <npystream/npy_header.hpp>
+#include <npystream/npyreader.hpp>
+#include <npystream/wide_stream.hpp>
+
+#include "check.hpp"
+
+int main() {
+  npystream::test::ScratchDirectory const dir{"wide_stream"};
+
+  size_t constexpr columns = 3000, rows = 100;
+  std::vector<float> data(columns * rows);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<float>(i);
+  }
+
+  {
+    npystream::WideNpyStream<float> stream{dir / "wide.npy", columns};
+    CHECK(stream.columns() == columns);
+    std::span<float const> const all{data};
+    for (size_t r = 0; r < rows / 2; ++r) {
+      stream << all.subspan(r * columns, columns);
+    }
+    stream.write(all.subspan(rows / 2 * columns));
+    CHECK_THROWS(std::runtime_error, stream << all.first(columns - 1));
+    CHECK_THROWS(std::runtime_error, stream.write(all.first(columns + 1)));
+    stream.close();
+  }
+
+  npystream::MappedFile const file{dir / "wide.npy"};
+  auto const header = npystream::parse_npy_header(file.bytes());
+  CHECK(header.shape.size() == 1 && header.shape[0] == rows);
+  CHECK(header.labels.size() == columns);
+  CHECK(header.labels[0] == "f0" && header.labels[columns - 1] == "f2999");
+  CHECK(file.bytes().size() == header.data_offset + data.size() * sizeof(float));
+  CHECK(std::memcmp(file.bytes().data() + header.data_offset, data.data(),
+                    data.size() * sizeof(float)) == 0);
+
+  // few labelled columns are readable as ordinary structured file
+  {
+    npystream::WideNpyStream<int32_t> stream{dir / "narrow.npy", std::array{"x", "y", "z"}};
+    std::array<int32_t, 3> const row{1, 2, 3};
+    stream << std::span<int32_t const>{row};
+  }
+  npystream::NpyReader<int32_t, int32_t, int32_t> const narrow{dir / "narrow.npy"};
+  CHECK(narrow.size() == 1);
+  CHECK(narrow.labels()[2] == "z");
+  CHECK(narrow[0] == std::tuple{1, 2, 3});
+
+  return npystream::test::result();
+}
@@ -0,0 +1,112 @@
+// Copyright (C) 2024 Maximilian Reininghaus
+// Released under European Union Public License 1.2,
+// see LICENSE file
+// SPDX-License-Identifier: EUPL-1.2
+
+// Zone maps written by NpyStream: block ranges, range scans against a full scan, and
+// sidecars that are stale, do not fit the data or are damaged, which readers ignore.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <npystream/npyreader.hpp>
+#include <npystream/npystream.hpp>
+#include <npystream/record_observer.hpp>
+
+#include "check.hpp"
+
+namespace {
+using Reader = npystream::NpyReader<int64_t, float>;
+
+//! records of scan<0>(lo, hi), compared against a full scan of the file
+std::vector<uint64_t> scan_matches(Reader const& reader, int64_t lo, int64_t hi) {
+  std::vector<uint64_t> matches, expected;
+  reader.scan<0>(lo, hi, [&](uint64_t i) { matches.push_back(i); });
+  for (uint64_t i = 0; i < reader.size(); ++i) {
+    if (reader.get<0>(i) >= lo && reader.get<0>(i) <= hi) {
+      expected.push_back(i);
+    }
+  }
+  CHECK(matches == expected);
+  return matches;
+}
+
+void write_file(std::filesystem::path const& path, int64_t records, bool zone_map) {
+  npystream::NpyStream<int64_t, float> stream{path, std::array{"ts", "value"}};
+  if (zone_map) {
+    stream.add_zone_map<0>(100);
+  }
+  for (int64_t i = 0; i < records; ++i) {
+    // mostly increasing timestamps with a few outliers
+    stream << std::tuple{(i % 1000 == 999) ? -i : i, static_cast<float>(i)};
+  }
+}
+} // namespace
+
+int main() {
+  npystream::test::ScratchDirectory const dir{"zone_map"};
+  auto const path = dir / "data.npy";
+  auto const sidecar = npystream::sidecar_path(path, ".zonemap.npy");
+
+  write_file(path, 10'050, true);
+  {
+    Reader const reader{path};
+    CHECK(reader.zone_map().has_value());
+    auto const& zones = *reader.zone_map();
+    CHECK(zones.blocks() == 101);
+    CHECK(zones.first_record(100) == 10'000);
+    auto const column = zones.column("ts");
+    CHECK(column.has_value() && !zones.column("value"));
+    CHECK(zones.range<int64_t>(3, *column) == std::pair<int64_t, int64_t>{300, 399});
+    CHECK(zones.range<int64_t>(9, *column) == std::pair<int64_t, int64_t>{-999, 998});
+    CHECK_THROWS(std::runtime_error, zones.range<double>(0, *column));
+
+    CHECK(scan_matches(reader, 4321, 4400).size() == 80);
+    CHECK(scan_matches(reader, -5000, -1000).size() == 4);
+    CHECK(scan_matches(reader, 20'000, 30'000).empty());
+  }
+
+  // the data file is rewritten without a zone map: the sidecar of the old file is stale
+  auto const old_time = std::filesystem::last_write_time(sidecar);
+  write_file(path, 10'050, false);
+  std::filesystem::last_write_time(sidecar, old_time - std::chrono::hours{1});
+  {
+    Reader const reader{path};
+    CHECK(!reader.zone_map());
+    CHECK(scan_matches(reader, 4321, 4400).size() == 80);
+  }
+
+  // up to date, but from a file with a different number of records
+  write_file(dir / "other.npy", 5000, true);
+  std::filesystem::copy_file(npystream::sidecar_path(dir / "other.npy", ".zonemap.npy"), sidecar,
+                             std::filesystem::copy_options::overwrite_existing);
+  std::filesystem::last_write_time(sidecar, std::filesystem::last_write_time(path) +
+                                                std::chrono::hours{1});
+  {
+    Reader const reader{path};
+    CHECK(!reader.zone_map());
+    CHECK(scan_matches(reader, 6000, 6100).size() == 101);
+  }
+
+  // damaged sidecars do not prevent opening the data
+  {
+    std::ofstream out{sidecar, std::ios::binary | std::ios::trunc};
+    out << "\x93NUMPY garbage";
+  }
+  std::filesystem::last_write_time(sidecar, std::filesystem::last_write_time(path) +
+                                                std::chrono::hours{1});
+  {
+    Reader const reader{path};
+    CHECK(!reader.zone_map());
+    CHECK(reader.size() == 10'050);
+  }
+
+  return npystream::test::result();
+}